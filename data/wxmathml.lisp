@@ -28,6 +28,30 @@
 
 (defvar $wxfilename "")
 
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;;
+;; Framed output. When wxMaxima sets *wx-framed* to t, math, main prompts
+;; and symbol lists are sent as <STX><type><length>:<payload>, where length
+;; is the length of the payload in bytes. wxMaxima can then skip the
+;; payload instead of searching it for the end tags.
+;;
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+(defvar *wx-framed* nil)
+
+(defun wx-utf8-length (str)
+  (if (<= char-code-limit 256)
+      ;; lisps with 8-bit characters send the (utf-8) bytes unchanged
+      (length str)
+      (loop for c across str
+	 sum (let ((code (char-code c)))
+	       (cond ((< code #x80) 1)
+		     ((< code #x800) 2)
+		     ((< code #x10000) 3)
+		     (t 4))))))
+
+(defun wx-frame (type str)
+  (format nil "~a~a~d:~a" (code-char 2) type (wx-utf8-length str) str))
+
 (defun tofiledir (file)
   (let ((path (pathname file)))
     (namestring (make-pathname :device (pathname-device path) :directory (pathname-directory path)))))
@@ -1042,8 +1066,11 @@
 (defun mydispla (x)
   (let ((*print-circle* nil)
         (*wxxml-mratp* (format nil "~{~a~}" (cdr (checkrat x)))))
-    (mapc #'princ
-          (wxxml x '("<mth>") '("</mth>") 'mparen 'mparen))))
+    (if *wx-framed*
+        (princ (wx-frame "M" (format nil "~{~a~}"
+                                     (wxxml x '("<mth>") '("</mth>") 'mparen 'mparen))))
+        (mapc #'princ
+              (wxxml x '("<mth>") '("</mth>") 'mparen 'mparen)))))
 
 (setf *alt-display2d* 'mydispla)
 
@@ -1610,6 +1637,12 @@
 ;; used for autocompletion.
 ;;
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+(defun wx-print-symbols (symbols)
+  (let ((*print-circle* nil))
+    (if *wx-framed*
+        (princ (wx-frame "S" (format nil "~{~a~^$~}" symbols)))
+        (format t "<wxxml-symbols>~{~a~^$~}</wxxml-symbols>" symbols))))
+
 (defun symbol-to-string (s)
   (maybe-invert-string-case (symbol-name (stripdollar s))))
 
@@ -1627,7 +1660,7 @@
 
 (defun $add_function_template (&rest functs)
   (let ((*print-circle* nil))
-    (format t "<wxxml-symbols>~{~a~^$~}</wxxml-symbols>" (mapcar #'$print_function functs))
+    (wx-print-symbols (mapcar #'$print_function functs))
     (cons '(mlist simp) functs)))
 
 ;;;
@@ -1644,9 +1677,9 @@
      (case type
        (($maxima)
 	($batchload searched-for)
-	(format t "<wxxml-symbols>~{~a~^$~}</wxxml-symbols>"
-		(append (mapcar #'$print_function (cdr ($append $functions $macros)))
-			(mapcar #'symbol-to-string (cdr $values)))))
+	(wx-print-symbols
+	 (append (mapcar #'$print_function (cdr ($append $functions $macros)))
+		 (mapcar #'symbol-to-string (cdr $values)))))
        (($lisp $object)
 	;; do something about handling errors
 	;; during loading. Foobar fail act errors.
@@ -1708,8 +1741,76 @@
 
 ;; Load the initial functions (from mac-init.mac)
 (let ((*print-circle* nil))
-  (format t "<wxxml-symbols>~{~a~^$~}</wxxml-symbols>"
-	  (mapcar #'$print_function (cdr ($append $functions $macros)))))
+  (wx-print-symbols (mapcar #'$print_function (cdr ($append $functions $macros)))))
+
+;; Main prompts are framed, too. Questions still use the prompt prefix and
+;; suffix. Like maxima's main-prompt the label is left out when
+;; *display-labels-p* is nil (older maxima versions always show it).
+(when (fboundp 'main-prompt)
+  (let ((main-prompt (symbol-function 'main-prompt)))
+    (no-warning
+     (defun main-prompt ()
+       (if *wx-framed*
+	   (wx-frame "P" (if (or (not (boundp '*display-labels-p*))
+				 (symbol-value '*display-labels-p*))
+			     (format nil "(~A~D) "
+				     (maybe-invert-string-case (symbol-name (stripdollar $inchar)))
+				     $linenum)
+			     ""))
+	   (funcall main-prompt))))))
+
+;; Pipelined evaluation. wxMaxima may send the next inputs before the
+;; current one is finished. Every input of a pipelined run is preceded by
+;; :lisp-quiet (wx-gate), which drops the input if an earlier input of the
+;; run ended with an error or wxMaxima created the cancel file (after an
+;; interrupt). Dropped inputs are reported with <wxxml-skipped/>.
+(defvar *wx-pipeline-active* nil)
+(defvar *wx-pipeline-cancel* nil)
+(defvar *wx-pipeline-cancel-file* nil)
+(defvar *wx-pipeline-error* nil)
+(defvar *wx-in-retrieve* nil)
+
+(defun wx-pipeline-start (cancel-file)
+  (setq *wx-pipeline-active* t)
+  (setq *wx-pipeline-cancel-file* cancel-file)
+  (setq *wx-pipeline-error* $error)
+  ;; Without the hooks below questions would eat the inputs sent ahead
+  (setq *wx-pipeline-cancel*
+	(not (and (fboundp 'retrieve) (fboundp 'mread-noprompt)))))
+
+(defun wx-pipeline-stop ()
+  (setq *wx-pipeline-active* nil))
+
+(defun wx-pipeline-end ()
+  nil)
+
+(defun wx-gate ()
+  (when (or *wx-pipeline-cancel*
+	    (not (eq $error *wx-pipeline-error*))
+	    (and *wx-pipeline-cancel-file*
+		 (probe-file *wx-pipeline-cancel-file*)))
+    (setq *wx-pipeline-cancel* t)
+    (read-line *standard-input* nil)
+    (princ "<wxxml-skipped/>")
+    (finish-output)))
+
+;; When a question is asked during a pipelined run the inputs which were
+;; already sent are dropped, up to the line wxMaxima sends when it sees
+;; the question. wxMaxima sends them again later.
+(when (and (fboundp 'retrieve) (fboundp 'mread-noprompt))
+  (let ((retrieve (symbol-function 'retrieve))
+	(mread-noprompt (symbol-function 'mread-noprompt)))
+    (no-warning
+     (defun retrieve (&rest args)
+       (let ((*wx-in-retrieve* t))
+	 (apply retrieve args))))
+    (no-warning
+     (defun mread-noprompt (&rest args)
+       (when (and *wx-in-retrieve* *wx-pipeline-active*)
+	 (finish-output)
+	 (loop for line = (read-line *standard-input* nil nil)
+	       until (or (null line) (search "(wx-pipeline-end)" line))))
+       (apply mread-noprompt args)))))
 
 (no-warning
  (defun mredef-check (fnname)
@@ -31,8 +31,7 @@ AbsCell::~AbsCell()
 {
   if (m_innerCell != NULL)
     delete m_innerCell;
-  if (m_next != NULL)
-    delete m_next;
+  DeleteNext();
   delete m_open;
   delete m_close;
 }
@@ -49,13 +48,20 @@ void AbsCell::SetParent(MathCell *parent, bool all)
   MathCell::SetParent(parent, all);
 }
 
+void AbsCell::GetInnerCells(std::vector<MathCell*>& cells)
+{
+  cells.push_back(m_innerCell);
+  cells.push_back(m_open);
+  cells.push_back(m_close);
+}
+
 MathCell* AbsCell::Copy(bool all)
 {
   AbsCell* tmp = new AbsCell;
   CopyData(this, tmp);
   tmp->SetInner(m_innerCell->Copy(true));
-  if (all && m_next != NULL)
-    tmp->AppendCell(m_next->Copy(all));
+  if (all)
+    CopyNext(tmp);
   return tmp;
 }
 
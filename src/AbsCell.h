@@ -34,6 +34,7 @@ public:
   bool BreakUp();
   void Unbreak(bool all);
   void SetParent(MathCell *parent, bool all);
+  void GetInnerCells(std::vector<MathCell*>& cells);
 protected:
   MathCell *m_innerCell;
   MathCell *m_open, *m_close, *m_last;
@@ -31,8 +31,7 @@ AtCell::~AtCell()
     delete m_baseCell;
   if (m_indexCell != NULL)
     delete m_indexCell;
-  if (m_next != NULL)
-    delete m_next;
+  DeleteNext();
 }
 
 void AtCell::SetParent(MathCell *parent, bool all)
@@ -45,14 +44,20 @@ void AtCell::SetParent(MathCell *parent, bool all)
   MathCell::SetParent(parent, all);
 }
 
+void AtCell::GetInnerCells(std::vector<MathCell*>& cells)
+{
+  cells.push_back(m_baseCell);
+  cells.push_back(m_indexCell);
+}
+
 MathCell* AtCell::Copy(bool all)
 {
   AtCell* tmp = new AtCell;
   CopyData(this, tmp);
   tmp->SetBase(m_baseCell->Copy(true));
   tmp->SetIndex(m_indexCell->Copy(true));
-  if (all && m_next != NULL)
-    tmp->AppendCell(m_next->Copy(all));
+  if (all)
+    CopyNext(tmp);
   return tmp;
 }
 
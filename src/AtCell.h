@@ -39,6 +39,7 @@ public:
 	wxString ToXML(bool all);	//new!!!
   void SelectInner(wxRect& rect, MathCell** first, MathCell** last);
   void SetParent(MathCell *parent, bool all);
+  void GetInnerCells(std::vector<MathCell*>& cells);
 protected:
   MathCell *m_baseCell;
   MathCell *m_indexCell;
@@ -23,6 +23,8 @@
 #include <wx/config.h>
 #include "MathCell.h"
 
+long CellParser::m_passes = 0;
+
 CellParser::CellParser(wxDC& dc) : m_dc(dc)
 {
   m_scale = 1.0;
@@ -30,23 +32,11 @@ CellParser::CellParser(wxDC& dc) : m_dc(dc)
   m_top = -1;
   m_bottom = -1;
   m_forceUpdate = false;
+  m_cacheOutput = false;
   m_indent = MC_GROUP_LEFT_INDENT;
   m_changeAsterisk = false;
   m_outdated = false;
-  m_TeXFonts = false;
-
-  if (wxFontEnumerator::IsValidFacename(m_fontCMEX = wxT("jsMath-cmex10")) &&
-      wxFontEnumerator::IsValidFacename(m_fontCMSY = wxT("jsMath-cmsy10")) &&
-      wxFontEnumerator::IsValidFacename(m_fontCMRI = wxT("jsMath-cmr10")) &&
-      wxFontEnumerator::IsValidFacename(m_fontCMMI = wxT("jsMath-cmmi10")) &&
-      wxFontEnumerator::IsValidFacename(m_fontCMTI = wxT("jsMath-cmti10")))
-  {
-    m_TeXFonts = true;
-    wxConfig::Get()->Read(wxT("usejsmath"), &m_TeXFonts);
-  }
-
-  m_keepPercent = true;
-  wxConfig::Get()->Read(wxT("keepPercent"), &m_keepPercent);
+  m_pass = ++m_passes;
 
   ReadStyle();
 }
@@ -58,44 +48,96 @@ CellParser::CellParser(wxDC& dc, double scale) : m_dc(dc)
   m_top = -1;
   m_bottom = -1;
   m_forceUpdate = false;
+  m_cacheOutput = false;
   m_indent = MC_GROUP_LEFT_INDENT;
   m_changeAsterisk = false;
   m_outdated = false;
-  m_TeXFonts = false;
-
-  if (wxFontEnumerator::IsValidFacename(m_fontCMEX = wxT("jsMath-cmex10")) &&
-      wxFontEnumerator::IsValidFacename(m_fontCMSY = wxT("jsMath-cmsy10")) &&
-      wxFontEnumerator::IsValidFacename(m_fontCMRI = wxT("jsMath-cmr10")) &&
-      wxFontEnumerator::IsValidFacename(m_fontCMMI = wxT("jsMath-cmmi10")) &&
-      wxFontEnumerator::IsValidFacename(m_fontCMTI = wxT("jsMath-cmti10")))
-  {
-    m_TeXFonts = true;
-    wxConfig::Get()->Read(wxT("usejsmath"), &m_TeXFonts);
-  }
-
-  m_keepPercent = true;
-  wxConfig::Get()->Read(wxT("keepPercent"), &m_keepPercent);
+  m_pass = ++m_passes;
 
   ReadStyle();
 }
 
+CellParser::CellParser(const CellParser& parser, wxDC& dc) : m_dc(dc)
+{
+  m_scale = parser.m_scale;
+  m_zoomFactor = parser.m_zoomFactor;
+  m_top = parser.m_top;
+  m_bottom = parser.m_bottom;
+  m_forceUpdate = parser.m_forceUpdate;
+  m_cacheOutput = parser.m_cacheOutput;
+  m_indent = parser.m_indent;
+  m_changeAsterisk = parser.m_changeAsterisk;
+  m_outdated = parser.m_outdated;
+  m_clientWidth = parser.m_clientWidth;
+  m_pass = parser.m_pass;
+  m_style = parser.m_style;
+}
+
 CellParser::~CellParser()
 {}
 
 wxString CellParser::GetFontName(int type)
 {
   if (type == TS_TITLE || type == TS_SUBSECTION || type == TS_SECTION || type == TS_TEXT)
-    return m_styles[type].font;
+    return m_style->m_styles[type].font;
   else if (type == TS_NUMBER || type == TS_VARIABLE || type == TS_FUNCTION ||
       type == TS_SPECIAL_CONSTANT || type == TS_STRING)
-    return m_mathFontName;
-  return m_fontName;
+    return m_style->m_mathFontName;
+  return m_style->m_fontName;
 }
 
+/***
+ * Uses the current style snapshot. The snapshot is only read from the
+ * configuration again after StyleSnapshot::Rebuild.
+ */
 void CellParser::ReadStyle()
+{
+  m_style = StyleSnapshot::Get();
+  m_dc.SetPen(*(wxThePenList->FindOrCreatePen(m_style->m_styles[TS_DEFAULT].color, 1, wxSOLID)));
+}
+
+StyleSnapshot *StyleSnapshot::m_current = NULL;
+StyleSnapshot *StyleSnapshot::m_previous = NULL;
+bool StyleSnapshot::m_stale = true;
+long StyleSnapshot::m_builds = 0;
+
+const StyleSnapshot* StyleSnapshot::Get()
+{
+  if (m_stale || m_current == NULL)
+  {
+    // CellParsers created before Rebuild may still point to m_current
+    delete m_previous;
+    m_previous = m_current;
+    m_current = new StyleSnapshot();
+    m_stale = false;
+    m_builds++;
+  }
+  return m_current;
+}
+
+void StyleSnapshot::Rebuild()
+{
+  m_stale = true;
+}
+
+StyleSnapshot::StyleSnapshot()
 {
   wxConfigBase* config = wxConfig::Get();
 
+  m_TeXFonts = false;
+  if (wxFontEnumerator::IsValidFacename(m_fontCMEX = wxT("jsMath-cmex10")) &&
+      wxFontEnumerator::IsValidFacename(m_fontCMSY = wxT("jsMath-cmsy10")) &&
+      wxFontEnumerator::IsValidFacename(m_fontCMRI = wxT("jsMath-cmr10")) &&
+      wxFontEnumerator::IsValidFacename(m_fontCMMI = wxT("jsMath-cmmi10")) &&
+      wxFontEnumerator::IsValidFacename(m_fontCMTI = wxT("jsMath-cmti10")))
+  {
+    m_TeXFonts = true;
+    config->Read(wxT("usejsmath"), &m_TeXFonts);
+  }
+
+  m_keepPercent = true;
+  config->Read(wxT("keepPercent"), &m_keepPercent);
+
   // Font
   config->Read(wxT("Style/fontname"), &m_fontName);
 
@@ -288,27 +330,25 @@ void CellParser::ReadStyle()
 
 
 #undef READ_STYLES
-
-  m_dc.SetPen(*(wxThePenList->FindOrCreatePen(m_styles[TS_DEFAULT].color, 1, wxSOLID)));
 }
 
 wxFontWeight CellParser::IsBold(int st)
 {
-  if (m_styles[st].bold)
+  if (m_style->m_styles[st].bold)
     return wxFONTWEIGHT_BOLD;
   return wxFONTWEIGHT_NORMAL;
 }
 
 int CellParser::IsItalic(int st)
 {
-  if (m_styles[st].italic)
+  if (m_style->m_styles[st].italic)
     return wxFONTSTYLE_SLANT;
   return wxFONTSTYLE_NORMAL;
 }
 
 bool CellParser::IsUnderlined(int st)
 {
-  return m_styles[st].underlined;
+  return m_style->m_styles[st].underlined;
 }
 
 wxString CellParser::GetSymbolFontName()
@@ -316,14 +356,14 @@ wxString CellParser::GetSymbolFontName()
 #if defined __WXMSW__
   return wxT("Symbol");
 #endif
-  return m_fontName;
+  return m_style->m_fontName;
 }
 
 wxColour CellParser::GetColor(int st)
 {
   if (m_outdated)
-    return m_styles[TS_OUTDATED].color;
-  return m_styles[st].color;
+    return m_style->m_styles[TS_OUTDATED].color;
+  return m_style->m_styles[st].color;
 }
 
 /*
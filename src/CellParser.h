@@ -24,14 +24,45 @@
 #include <wx/fontenum.h>
 
 #include "TextStyle.h"
+#include "FontCache.h"
 
 #include "Setup.h"
 
+/***
+ * The styles and fonts from the configuration. Reading them takes many
+ * wxConfig reads and a font enumeration, so they are read once and shared
+ * by all CellParsers. Rebuild has to be called when the configuration
+ * changes.
+ */
+class StyleSnapshot
+{
+public:
+  static const StyleSnapshot* Get();
+  static void Rebuild();
+  static long GetBuildCount() { return m_builds; }
+  wxString m_fontName;
+  int m_defaultFontSize, m_mathFontSize;
+  wxString m_mathFontName;
+  bool m_TeXFonts;
+  bool m_keepPercent;
+  wxString m_fontCMRI, m_fontCMSY, m_fontCMEX, m_fontCMMI, m_fontCMTI;
+  wxFontEncoding m_fontEncoding;
+  style m_styles[STYLE_NUM];
+private:
+  StyleSnapshot();
+  static StyleSnapshot *m_current;
+  static StyleSnapshot *m_previous;   // may still be used by a CellParser
+  static bool m_stale;
+  static long m_builds;
+};
+
 class CellParser
 {
 public:
   CellParser(wxDC& dc);
   CellParser(wxDC& dc, double scale);
+  // same settings as parser, drawing to dc
+  CellParser(const CellParser& parser, wxDC& dc);
   ~CellParser();
   void SetZoomFactor(double newzoom) { m_zoomFactor = newzoom; }
   void SetScale(double scale) { m_scale = scale; }
@@ -64,9 +95,14 @@ public:
   {
     return m_forceUpdate;
   }
+  // Each CellParser (and its copies) is one layout pass
+  long GetPass() { return m_pass; }
+  // GroupCells may draw their output from OutputCache
+  void SetCacheOutput(bool cache) { m_cacheOutput = cache; }
+  bool CacheOutput() { return m_cacheOutput; }
   wxFontEncoding GetFontEncoding()
   {
-    return m_fontEncoding;
+    return m_style->m_fontEncoding;
   }
   bool GetChangeAsterisk()
   {
@@ -80,40 +116,37 @@ public:
   void SetIndent(int indent) { m_indent = indent; }
   void SetClientWidth(int width) { m_clientWidth = width; }
   int GetClientWidth() { return m_clientWidth; }
-  int GetDefaultFontSize() { return int(m_zoomFactor * double(m_defaultFontSize)); }
-  int GetMathFontSize() { return int(m_zoomFactor * double(m_mathFontSize)); }
+  int GetDefaultFontSize() { return int(m_zoomFactor * double(m_style->m_defaultFontSize)); }
+  int GetMathFontSize() { return int(m_zoomFactor * double(m_style->m_mathFontSize)); }
   int GetFontSize(int st)
   {
     if (st == TS_TEXT || st == TS_SUBSECTION || st == TS_SECTION || st == TS_TITLE)
-      return int(m_zoomFactor * double(m_styles[st].fontSize));
+      return int(m_zoomFactor * double(m_style->m_styles[st].fontSize));
     return 0;
   }
   void Outdated(bool outdated) { m_outdated = outdated; }
-  bool CheckTeXFonts() { return m_TeXFonts; }
-  bool CheckKeepPercent() { return m_keepPercent; }
-  wxString GetTeXCMRI() { return m_fontCMRI; }
-  wxString GetTeXCMSY() { return m_fontCMSY; }
-  wxString GetTeXCMEX() { return m_fontCMEX; }
-  wxString GetTeXCMMI() { return m_fontCMMI; }
-  wxString GetTeXCMTI() { return m_fontCMTI; }
+  bool IsOutdated() { return m_outdated; }
+  bool CheckTeXFonts() { return m_style->m_TeXFonts; }
+  bool CheckKeepPercent() { return m_style->m_keepPercent; }
+  wxString GetTeXCMRI() { return m_style->m_fontCMRI; }
+  wxString GetTeXCMSY() { return m_style->m_fontCMSY; }
+  wxString GetTeXCMEX() { return m_style->m_fontCMEX; }
+  wxString GetTeXCMMI() { return m_style->m_fontCMMI; }
+  wxString GetTeXCMTI() { return m_style->m_fontCMTI; }
 private:
   int m_indent;
   double m_scale;
   double m_zoomFactor;
   wxDC& m_dc;
   int m_top, m_bottom;
-  wxString m_fontName;
-  int m_defaultFontSize, m_mathFontSize;
-  wxString m_mathFontName;
   bool m_forceUpdate;
+  bool m_cacheOutput;
   bool m_changeAsterisk;
   bool m_outdated;
-  bool m_TeXFonts;
-  bool m_keepPercent;
-  wxString m_fontCMRI, m_fontCMSY, m_fontCMEX, m_fontCMMI, m_fontCMTI;
   int m_clientWidth;
-  wxFontEncoding m_fontEncoding;
-  style m_styles[STYLE_NUM];
+  long m_pass;
+  static long m_passes;
+  const StyleSnapshot *m_style;
 };
 
 #endif
@@ -0,0 +1,134 @@
+///
+///  Copyright (C) 2013 The wxMaxima team
+///
+///  This program is free software; you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation; either version 2 of the License, or
+///  (at your option) any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program; if not, write to the Free Software
+///  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+///
+
+
+#include "CellPool.h"
+
+#if wxUSE_THREADS
+#include <wx/thread.h>
+
+static wxCriticalSection poolLock;
+#endif
+
+std::map<char*, CellPool::Chunk*> CellPool::m_chunks;
+std::vector<std::set<CellPool::Chunk*> > CellPool::m_open(CELL_POOL_MAX_SIZE / CELL_POOL_ALIGN + 1);
+long CellPool::m_cells = 0;
+
+void *CellPool::Allocate(size_t size)
+{
+  if (size > CELL_POOL_MAX_SIZE)
+    return ::operator new(size);
+
+  size_t index = (size + CELL_POOL_ALIGN - 1) / CELL_POOL_ALIGN;
+
+#if wxUSE_THREADS
+  wxCriticalSectionLocker lock(poolLock);
+#endif
+
+  std::set<Chunk*>& open = m_open[index];
+  Chunk *chunk;
+  if (open.empty())
+  {
+    chunk = new Chunk;
+    chunk->memory = new char[CELL_POOL_CHUNK];
+    chunk->size = index * CELL_POOL_ALIGN;
+    chunk->used = 0;
+    chunk->free = NULL;
+    chunk->cells = 0;
+    m_chunks[chunk->memory] = chunk;
+    open.insert(chunk);
+  }
+  else
+    chunk = *open.begin();
+
+  // A deleted cell or the unused part of the chunk
+  void *p = chunk->free;
+  if (p != NULL)
+    chunk->free = *(void**)p;
+  else
+  {
+    p = chunk->memory + chunk->used;
+    chunk->used += chunk->size;
+  }
+
+  chunk->cells++;
+  m_cells++;
+  if (chunk->IsFull())
+    open.erase(chunk);
+  return p;
+}
+
+void CellPool::Free(void *p, size_t size)
+{
+  if (p == NULL)
+    return;
+  if (size > CELL_POOL_MAX_SIZE)
+  {
+    ::operator delete(p);
+    return;
+  }
+
+#if wxUSE_THREADS
+  wxCriticalSectionLocker lock(poolLock);
+#endif
+
+  // The chunk which starts last before p
+  std::map<char*, Chunk*>::iterator it = m_chunks.upper_bound((char*)p);
+  --it;
+  Chunk *chunk = it->second;
+  std::set<Chunk*>& open = m_open[chunk->size / CELL_POOL_ALIGN];
+
+  if (chunk->IsFull())
+    open.insert(chunk);
+  *(void**)p = chunk->free;
+  chunk->free = p;
+  chunk->cells--;
+  m_cells--;
+
+  if (chunk->cells > 0)
+    return;
+
+  if (m_cells == 0)
+    Release();
+  else if (open.size() > 1)
+  {
+    open.erase(chunk);
+    m_chunks.erase(it);
+    delete [] chunk->memory;
+    delete chunk;
+  }
+  else
+  {
+    // Keep the last chunk of this size, but start it over
+    chunk->used = 0;
+    chunk->free = NULL;
+  }
+}
+
+void CellPool::Release()
+{
+  for (std::map<char*, Chunk*>::iterator it = m_chunks.begin(); it != m_chunks.end(); ++it)
+  {
+    delete [] it->second->memory;
+    delete it->second;
+  }
+  m_chunks.clear();
+  for (size_t i = 0; i < m_open.size(); i++)
+    m_open[i].clear();
+}
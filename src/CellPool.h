@@ -0,0 +1,71 @@
+///
+///  Copyright (C) 2013 The wxMaxima team
+///
+///  This program is free software; you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation; either version 2 of the License, or
+///  (at your option) any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program; if not, write to the Free Software
+///  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+///
+
+
+#ifndef _CELLPOOL_H_
+#define _CELLPOOL_H_
+
+#include <wx/wx.h>
+
+#include <vector>
+#include <map>
+#include <set>
+
+#define CELL_POOL_CHUNK 65536      // bytes allocated at once
+#define CELL_POOL_ALIGN 16
+#define CELL_POOL_MAX_SIZE 512     // larger cells come from the heap
+
+/***
+ * CellPool allocates the memory of output cells (see MathCell::operator new).
+ * Cells are carved from chunks of CELL_POOL_CHUNK bytes which hold cells of
+ * one size, and deleted cells are kept in a free list of their chunk, so
+ * rebuilding a large output takes the memory of the old one instead of
+ * calling malloc and free for each cell.
+ *
+ * Each chunk counts its cells. A chunk is released when its last cell is
+ * deleted, unless it is the only chunk of its size with room left, so the
+ * memory of a deleted output goes back even while other outputs are shown.
+ * All chunks are released when the last pooled cell is deleted.
+ *
+ * Output is parsed on worker threads (ParserPool), so the pool is locked.
+ */
+class CellPool
+{
+public:
+  static void *Allocate(size_t size);
+  static void Free(void *p, size_t size);
+  static long GetCells() { return m_cells; }
+  static long GetBytes() { return (long)(m_chunks.size() * CELL_POOL_CHUNK); }
+private:
+  struct Chunk
+  {
+    char *memory;
+    size_t size;      // of its cells
+    size_t used;      // bytes of memory which were handed out
+    void *free;       // first deleted cell
+    long cells;       // cells which are not deleted
+    bool IsFull() { return free == NULL && used + size > CELL_POOL_CHUNK; }
+  };
+  static void Release();
+  static std::map<char*, Chunk*> m_chunks;        // by address
+  static std::vector<std::set<Chunk*> > m_open;   // chunks with room, by size
+  static long m_cells;                            // pooled cells which are not deleted
+};
+
+#endif // _CELLPOOL_H_
@@ -21,6 +21,8 @@
 
 #include "Config.h"
 #include "MathCell.h"
+#include "CellParser.h"
+#include "OutputCache.h"
 
 #include <wx/config.h>
 #include <wx/fileconf.h>
@@ -128,16 +130,39 @@ void Config::SetProperties()
   m_savePanes->SetToolTip(_("Save panes layout between sessions."));
   m_matchParens->SetToolTip(_("Write matching parenthesis in text controls."));
   m_showLong->SetToolTip(_("Show long expressions in wxMaxima document."));
+  m_lazyLong->SetToolTip(_("Show the first part of long expressions and the"
+                           " rest only when it is clicked."));
+  m_shareSubtrees->SetToolTip(_("Parse and measure subexpressions which repeat in an output"
+                                " only once. Repeated parts are not broken into lines."));
   m_language->SetToolTip(_("Language used for wxMaxima GUI."));
   m_fixedFontInTC->SetToolTip(_("Set fixed font in text controls."));
   m_getFont->SetToolTip(_("Font used for display in document."));
   m_getMathFont->SetToolTip(_("Font used for displaying math characters in document."));
   m_changeAsterisk->SetToolTip(_("Use centered dot character for multiplication"));
   m_defaultPort->SetToolTip(_("The default port used for communication between Maxima and wxMaxima."));
+  m_framedProtocol->SetToolTip(_("Maxima sends the length of each output, so that it doesn't have"
+                                 " to be searched for its end. Needs a Maxima which defines main-prompt."));
+  m_pipelineDepth->SetToolTip(_("Number of queued cells which are sent to Maxima before the"
+                                " previous ones are finished. 1 sends one cell at a time."));
+  m_floodControl->SetToolTip(_("Write the output of an evaluation to a file instead of the"
+                               " document when Maxima sends more than the limits below."));
+  m_floodCells->SetToolTip(_("Number of output lines an evaluation can add to the document."));
+  m_floodRate->SetToolTip(_("Maximum rate of output (in kilobytes per second) which is"
+                            " added to the document. Only output which stays faster for"
+                            " a few seconds is written to a file."));
+#if WXM_READER_THREAD
+  m_readerThread->SetToolTip(_("Read and split Maxima output in a separate thread, so that the"
+                               " document stays responsive while long outputs are read."));
+#endif
+#if WXM_PARSER_THREADS
+  m_parallelParsing->SetToolTip(_("Parse Maxima output on all processors. Helps when Maxima"
+                                  " displays many large expressions at once."));
+#endif
 
   wxConfig *config = (wxConfig *)wxConfig::Get();
   wxString mp, mc, ib, mf;
-  bool match = true, showLongExpr = false, savePanes = false;
+  bool match = true, showLongExpr = false, lazyLongExpr = false, savePanes = false;
+  bool shareSubtrees = false;
   bool fixedFontTC = true, changeAsterisk = false, usejsmath = true, keepPercent = true;
   bool enterEvaluates = false, saveUntitled = true, openHCaret = false;
   bool insertAns = true;
@@ -152,6 +177,8 @@ void Config::SetProperties()
   config->Read(wxT("pos-restore"), &rs);
   config->Read(wxT("matchParens"), &match);
   config->Read(wxT("showLong"), &showLongExpr);
+  config->Read(wxT("lazyLong"), &lazyLongExpr);
+  config->Read(wxT("shareSubtrees"), &shareSubtrees);
   config->Read(wxT("language"), &lang);
   config->Read(wxT("changeAsterisk"), &changeAsterisk);
   config->Read(wxT("fixedFontTC"), &fixedFontTC);
@@ -163,6 +190,30 @@ void Config::SetProperties()
   config->Read(wxT("fixReorderedIndices"), &fixReorderedIndices);
   config->Read(wxT("usejsmath"), &usejsmath);
   config->Read(wxT("keepPercent"), &keepPercent);
+  bool framedProtocol = false;
+  config->Read(wxT("framedProtocol"), &framedProtocol);
+  m_framedProtocol->SetValue(framedProtocol);
+  int pipelineDepth = 1;
+  config->Read(wxT("pipelineDepth"), &pipelineDepth);
+  m_pipelineDepth->SetValue(pipelineDepth);
+  bool floodControl = true;
+  int floodCells = 10000, floodRate = 2048;
+  config->Read(wxT("floodControl"), &floodControl);
+  config->Read(wxT("floodCells"), &floodCells);
+  config->Read(wxT("floodRate"), &floodRate);
+  m_floodControl->SetValue(floodControl);
+  m_floodCells->SetValue(floodCells);
+  m_floodRate->SetValue(floodRate);
+#if WXM_READER_THREAD
+  bool readerThread = false;
+  config->Read(wxT("readerThread"), &readerThread);
+  m_readerThread->SetValue(readerThread);
+#endif
+#if WXM_PARSER_THREADS
+  bool parallelParsing = false;
+  config->Read(wxT("parallelParsing"), &parallelParsing);
+  m_parallelParsing->SetValue(parallelParsing);
+#endif
 
   int i = 0;
   for (i = 0; i < LANGUAGE_NUMBER; i++)
@@ -209,6 +260,8 @@ void Config::SetProperties()
   m_savePanes->SetValue(savePanes);
   m_matchParens->SetValue(match);
   m_showLong->SetValue(showLongExpr);
+  m_lazyLong->SetValue(lazyLongExpr);
+  m_shareSubtrees->SetValue(shareSubtrees);
   m_changeAsterisk->SetValue(changeAsterisk);
   m_enterEvaluates->SetValue(enterEvaluates);
   m_saveUntitled->SetValue(saveUntitled);
@@ -273,6 +326,8 @@ wxPanel* Config::CreateOptionsPanel()
   m_matchParens = new wxCheckBox(panel, -1, _("Match parenthesis in text controls"));
   m_fixedFontInTC = new wxCheckBox(panel, -1, _("Fixed font in text controls"));
   m_showLong = new wxCheckBox(panel, -1, _("Show long expressions"));
+  m_lazyLong = new wxCheckBox(panel, -1, _("Show long expressions in parts"));
+  m_shareSubtrees = new wxCheckBox(panel, -1, _("Share repeated subexpressions"));
   m_changeAsterisk = new wxCheckBox(panel, -1, _("Use centered dot character for multiplication"));
   m_keepPercentWithSpecials = new wxCheckBox(panel, -1, _("Keep percent sign with special symbols: %e, %i, etc."));
   m_enterEvaluates = new wxCheckBox(panel, -1, _("Enter evaluates cells"));
@@ -295,6 +350,8 @@ wxPanel* Config::CreateOptionsPanel()
   vsizer->Add(m_matchParens, 0, wxALL, 5);
   vsizer->Add(m_fixedFontInTC, 0, wxALL, 5);
   vsizer->Add(m_showLong, 0, wxALL, 5);
+  vsizer->Add(m_lazyLong, 0, wxALL, 5);
+  vsizer->Add(m_shareSubtrees, 0, wxALL, 5);
   vsizer->Add(m_changeAsterisk, 0, wxALL, 5);
   vsizer->Add(m_keepPercentWithSpecials, 0, wxALL, 5);
   vsizer->Add(m_enterEvaluates, 0, wxALL, 5);
@@ -303,7 +360,7 @@ wxPanel* Config::CreateOptionsPanel()
   vsizer->Add(m_insertAns, 0, wxALL, 5);
   vsizer->Add(m_fixReorderedIndices, 0, wxALL, 5);
 
-  vsizer->AddGrowableRow(10);
+  vsizer->AddGrowableRow(11);
   panel->SetSizer(vsizer);
   vsizer->Fit(panel);
 
@@ -314,13 +371,27 @@ wxPanel* Config::CreateMaximaPanel()
 {
   wxPanel* panel = new wxPanel(m_notebook, -1);
 
-  wxFlexGridSizer* sizer = new wxFlexGridSizer(5, 2, 0, 0);
+  wxFlexGridSizer* sizer = new wxFlexGridSizer(12, 2, 0, 0);
 
   wxStaticText *mp = new wxStaticText(panel, -1, _("Maxima program:"));
   m_maximaProgram = new wxTextCtrl(panel, -1, wxEmptyString, wxDefaultPosition, wxSize(250, -1), wxTE_RICH);
   m_mpBrowse = new wxButton(panel, wxID_OPEN, _("Open"));
   wxStaticText *ap = new wxStaticText(panel, -1, _("Additional parameters:"));
   m_additionalParameters = new wxTextCtrl(panel, -1, wxEmptyString, wxDefaultPosition, wxSize(250, -1), wxTE_RICH);
+  m_framedProtocol = new wxCheckBox(panel, -1, _("Use framed output protocol"));
+  wxStaticText *pd = new wxStaticText(panel, -1, _("Cells sent to Maxima at once:"));
+  m_pipelineDepth = new wxSpinCtrl(panel, -1, wxEmptyString, wxDefaultPosition, wxSize(70, -1), wxSP_ARROW_KEYS, 1, 16, 1);
+  m_floodControl = new wxCheckBox(panel, -1, _("Write too much output to a file"));
+  wxStaticText *fc = new wxStaticText(panel, -1, _("Output lines per evaluation:"));
+  m_floodCells = new wxSpinCtrl(panel, -1, wxEmptyString, wxDefaultPosition, wxSize(70, -1), wxSP_ARROW_KEYS, 100, 1000000, 10000);
+  wxStaticText *fr = new wxStaticText(panel, -1, _("Output rate (kB/s):"));
+  m_floodRate = new wxSpinCtrl(panel, -1, wxEmptyString, wxDefaultPosition, wxSize(70, -1), wxSP_ARROW_KEYS, 16, 1000000, 2048);
+#if WXM_READER_THREAD
+  m_readerThread = new wxCheckBox(panel, -1, _("Read Maxima output in a background thread"));
+#endif
+#if WXM_PARSER_THREADS
+  m_parallelParsing = new wxCheckBox(panel, -1, _("Parse Maxima output in parallel"));
+#endif
 
   sizer->Add(mp, 0, wxALL | wxALIGN_CENTER_VERTICAL, 5);
   sizer->Add(10, 10);
@@ -331,6 +402,25 @@ wxPanel* Config::CreateMaximaPanel()
   sizer->Add(ap, 0, wxALL | wxALIGN_CENTER_VERTICAL, 5);
   sizer->Add(10, 10);
   sizer->Add(m_additionalParameters, 0, wxALL, 5);
+  sizer->Add(10, 10);
+  sizer->Add(m_framedProtocol, 0, wxALL, 5);
+  sizer->Add(10, 10);
+  sizer->Add(pd, 0, wxALL | wxALIGN_CENTER_VERTICAL, 5);
+  sizer->Add(m_pipelineDepth, 0, wxALL | wxALIGN_CENTER_VERTICAL, 5);
+  sizer->Add(m_floodControl, 0, wxALL, 5);
+  sizer->Add(10, 10);
+  sizer->Add(fc, 0, wxALL | wxALIGN_CENTER_VERTICAL, 5);
+  sizer->Add(m_floodCells, 0, wxALL | wxALIGN_CENTER_VERTICAL, 5);
+  sizer->Add(fr, 0, wxALL | wxALIGN_CENTER_VERTICAL, 5);
+  sizer->Add(m_floodRate, 0, wxALL | wxALIGN_CENTER_VERTICAL, 5);
+#if WXM_READER_THREAD
+  sizer->Add(m_readerThread, 0, wxALL, 5);
+  sizer->Add(10, 10);
+#endif
+#if WXM_PARSER_THREADS
+  sizer->Add(m_parallelParsing, 0, wxALL, 5);
+  sizer->Add(10, 10);
+#endif
 
   panel->SetSizer(sizer);
   sizer->Fit(panel);
@@ -455,6 +545,8 @@ void Config::WriteSettings()
   config->Write(wxT("mathFontsize"), m_mathFontSize);
   config->Write(wxT("matchParens"), m_matchParens->GetValue());
   config->Write(wxT("showLong"), m_showLong->GetValue());
+  config->Write(wxT("lazyLong"), m_lazyLong->GetValue());
+  config->Write(wxT("shareSubtrees"), m_shareSubtrees->GetValue());
   config->Write(wxT("fixedFontTC"), m_fixedFontInTC->GetValue());
   config->Write(wxT("changeAsterisk"), m_changeAsterisk->GetValue());
   config->Write(wxT("enterEvaluates"), m_enterEvaluates->GetValue());
@@ -466,6 +558,17 @@ void Config::WriteSettings()
   config->Write(wxT("AUI/savePanes"), m_savePanes->GetValue());
   config->Write(wxT("usejsmath"), m_useJSMath->GetValue());
   config->Write(wxT("keepPercent"), m_keepPercentWithSpecials->GetValue());
+  config->Write(wxT("framedProtocol"), m_framedProtocol->GetValue());
+  config->Write(wxT("pipelineDepth"), m_pipelineDepth->GetValue());
+  config->Write(wxT("floodControl"), m_floodControl->GetValue());
+  config->Write(wxT("floodCells"), m_floodCells->GetValue());
+  config->Write(wxT("floodRate"), m_floodRate->GetValue());
+#if WXM_READER_THREAD
+  config->Write(wxT("readerThread"), m_readerThread->GetValue());
+#endif
+#if WXM_PARSER_THREADS
+  config->Write(wxT("parallelParsing"), m_parallelParsing->GetValue());
+#endif
   if (m_saveSize->GetValue())
     config->Write(wxT("pos-restore"), 1);
   else
@@ -476,6 +579,10 @@ void Config::WriteSettings()
 
   WriteStyles();
   config->Flush();
+
+  StyleSnapshot::Rebuild();
+  FontCache::Clear();
+  OutputCache::Clear();
 }
 
 void Config::OnMpBrowse(wxCommandEvent& event)
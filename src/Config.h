@@ -35,6 +35,8 @@
 
 #include "TextStyle.h"
 #include "Setup.h"
+#include "MaximaReader.h"
+#include "ParserPool.h"
 
 enum {
   color_id,
@@ -106,6 +108,8 @@ protected:
   wxCheckBox* m_savePanes;
   wxCheckBox* m_matchParens;
   wxCheckBox* m_showLong;
+  wxCheckBox* m_lazyLong;
+  wxCheckBox* m_shareSubtrees;
   wxCheckBox* m_enterEvaluates;
   wxCheckBox* m_saveUntitled;
   wxCheckBox* m_openHCaret;
@@ -128,12 +132,23 @@ protected:
   wxCheckBox* m_changeAsterisk;
   wxCheckBox* m_useJSMath;
   wxCheckBox* m_keepPercentWithSpecials;
+  wxCheckBox* m_framedProtocol;
+#if WXM_READER_THREAD
+  wxCheckBox* m_readerThread;
+#endif
+#if WXM_PARSER_THREADS
+  wxCheckBox* m_parallelParsing;
+#endif
   wxBookCtrlBase* m_notebook;
   wxStaticText* m_mathFont;
   wxButton* m_getMathFont;
   wxString m_mathFontName;
   wxButton *m_saveStyle, *m_loadStyle;
   wxSpinCtrl* m_defaultPort;
+  wxSpinCtrl* m_pipelineDepth;
+  wxCheckBox* m_floodControl;
+  wxSpinCtrl* m_floodCells;
+  wxSpinCtrl* m_floodRate;
   ExamplePanel* m_examplePanel;
   // end wxGlade
   style m_styleDefault,
@@ -31,8 +31,7 @@ DiffCell::~DiffCell()
     delete m_baseCell;
   if (m_diffCell != NULL)
     delete m_diffCell;
-  if (m_next != NULL)
-    delete m_next;
+  DeleteNext();
 }
 
 void DiffCell::SetParent(MathCell *parent, bool all)
@@ -45,14 +44,20 @@ void DiffCell::SetParent(MathCell *parent, bool all)
   MathCell::SetParent(parent, all);
 }
 
+void DiffCell::GetInnerCells(std::vector<MathCell*>& cells)
+{
+  cells.push_back(m_baseCell);
+  cells.push_back(m_diffCell);
+}
+
 MathCell* DiffCell::Copy(bool all)
 {
   DiffCell* tmp = new DiffCell;
   CopyData(this, tmp);
   tmp->SetDiff(m_diffCell->Copy(true));
   tmp->SetBase(m_baseCell->Copy(true));
-  if (all && m_next!= NULL)
-    tmp->AppendCell(m_next->Copy(all));
+  if (all)
+    CopyNext(tmp);
   return tmp;
 }
 
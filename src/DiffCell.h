@@ -39,6 +39,7 @@ public:
   wxString ToTeX(bool all);
 	wxString ToXML(bool all);	//new!!
   void SetParent(MathCell *parent, bool all);
+  void GetInnerCells(std::vector<MathCell*>& cells);
 protected:
   MathCell *m_baseCell;
   MathCell *m_diffCell;
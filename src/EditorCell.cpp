@@ -54,8 +54,7 @@ EditorCell::EditorCell() : MathCell()
 
 EditorCell::~EditorCell()
 {
-  if (m_next != NULL)
-    delete m_next;
+  DeleteNext();
 }
 
 MathCell *EditorCell::Copy(bool all)
@@ -64,8 +63,8 @@ MathCell *EditorCell::Copy(bool all)
   tmp->SetValue(m_text);
   tmp->m_containsChanges = m_containsChanges;
   CopyData(this, tmp);
-  if (all && m_next != NULL)
-    tmp->AppendCell(m_next->Copy(all));
+  if (all)
+    CopyNext(tmp);
   return tmp;
 }
 
@@ -139,7 +138,7 @@ void EditorCell::RecalculateWidths(CellParser& parser, int fontsize, bool all)
     double scale = parser.GetScale();
     SetFont(parser, fontsize);
 
-    dc.GetTextExtent(wxT("X"), &m_charWidth, &m_charHeight);
+    FontCache::GetTextExtent(dc, wxT("X"), &m_charWidth, &m_charHeight);
 
     unsigned int newLinePos = 0, prevNewLinePos = 0;
     int width = 0, width1, height1;
@@ -155,7 +154,7 @@ void EditorCell::RecalculateWidths(CellParser& parser, int fontsize, bool all)
         newLinePos++;
       }
 
-      dc.GetTextExtent(m_text.SubString(prevNewLinePos, newLinePos), &width1, &height1);
+      FontCache::GetTextExtent(dc, m_text.SubString(prevNewLinePos, newLinePos), &width1, &height1);
       width = MAX(width, width1);
 
       while (newLinePos < m_text.Length() && m_text.GetChar(newLinePos) == '\n')
@@ -269,12 +268,12 @@ void EditorCell::Draw(CellParser& parser, wxPoint point1, int fontsize, bool all
 
         wxPoint point = PositionToPoint(parser, m_paren1);
         int width, height;
-        dc.GetTextExtent(m_text.GetChar(m_paren1), &width, &height);
+        FontCache::GetTextExtent(dc, m_text.GetChar(m_paren1), &width, &height);
         dc.DrawRectangle(point.x + SCALE_PX(2, scale) + 1,
                          point.y  + SCALE_PX(2, scale) - m_center + 1,
                          width - 1, height - 1);
         point = PositionToPoint(parser, m_paren2);
-        dc.GetTextExtent(m_text.GetChar(m_paren1), &width, &height);
+        FontCache::GetTextExtent(dc, m_text.GetChar(m_paren1), &width, &height);
         dc.DrawRectangle(point.x + SCALE_PX(2, scale) + 1,
                          point.y  + SCALE_PX(2, scale) - m_center + 1,
                          width - 1, height - 1);
@@ -351,7 +350,7 @@ void EditorCell::Draw(CellParser& parser, wxPoint point1, int fontsize, bool all
 
       wxString line = GetLineString(caretInLine, 0, caretInColumn);
       int lineWidth, lineHeight;
-      dc.GetTextExtent(line, &lineWidth, &lineHeight);
+      FontCache::GetTextExtent(dc, line, &lineWidth, &lineHeight);
 
       dc.SetPen(*(wxThePenList->FindOrCreatePen(parser.GetColor(TS_CURSOR), 1, wxSOLID))); //TODO is there more efficient way to do this?
 #if defined(__WXMAC__)
@@ -393,12 +392,12 @@ void EditorCell::SetFont(CellParser& parser, int fontsize)
   m_underlined = parser.IsUnderlined(m_textStyle);
   m_fontEncoding = parser.GetFontEncoding();
 
-  dc.SetFont(wxFont(fontsize1, wxFONTFAMILY_MODERN,
-                    m_fontStyle,
-                    m_fontWeight,
-                    m_underlined,
-                    m_fontName,
-                    m_fontEncoding));
+  dc.SetFont(FontCache::Get(fontsize1, wxFONTFAMILY_MODERN,
+                            m_fontStyle,
+                            m_fontWeight,
+                            m_underlined,
+                            m_fontName,
+                            m_fontEncoding));
 }
 
 void EditorCell::SetForeground(CellParser& parser)
@@ -1462,7 +1461,7 @@ wxPoint EditorCell::PositionToPoint(CellParser& parser, int pos)
   if (cX > 0)
     line = GetLineString(cY, 0, cX);
 
-  dc.GetTextExtent(line, &width, &height);
+  FontCache::GetTextExtent(dc, line, &width, &height);
 
   x += width;
   y += m_charHeight * cY;
@@ -1475,12 +1474,12 @@ void EditorCell::SelectPointText(wxDC& dc, wxPoint& point)
   wxString s;
   int fontsize1 = m_fontSize;
 
-  dc.SetFont(wxFont(fontsize1, wxFONTFAMILY_MODERN,
-                    m_fontStyle,
-                    m_fontWeight,
-                    m_underlined,
-                    m_fontName,
-                    m_fontEncoding));
+  dc.SetFont(FontCache::Get(fontsize1, wxFONTFAMILY_MODERN,
+                            m_fontStyle,
+                            m_fontWeight,
+                            m_underlined,
+                            m_fontName,
+                            m_fontEncoding));
 
   m_selectionEnd = m_selectionStart = -1;
   wxPoint translate(point);
@@ -1496,8 +1495,8 @@ void EditorCell::SelectPointText(wxDC& dc, wxPoint& point)
   while (m_positionOfCaret < (signed)m_text.Length() && m_text.GetChar(m_positionOfCaret) != '\n')
   {
     s = m_text.SubString(lineStart, m_positionOfCaret);
-    dc.GetTextExtent(m_text.SubString(lineStart, m_positionOfCaret),
-                                      &width, &height);
+    FontCache::GetTextExtent(dc, m_text.SubString(lineStart, m_positionOfCaret),
+                             &width, &height);
     if (width > translate.x)
       break;
 
@@ -1543,12 +1542,12 @@ bool EditorCell::IsPointInSelection(wxDC& dc, wxPoint point)
   wxString s;
   int fontsize1 = m_fontSize;
 
-  dc.SetFont(wxFont(fontsize1, wxFONTFAMILY_MODERN,
-                    m_fontStyle,
-                    m_fontWeight,
-                    m_underlined,
-                    m_fontName,
-                    m_fontEncoding));
+  dc.SetFont(FontCache::Get(fontsize1, wxFONTFAMILY_MODERN,
+                            m_fontStyle,
+                            m_fontWeight,
+                            m_underlined,
+                            m_fontName,
+                            m_fontEncoding));
   wxPoint translate(point);
   translate.x -= m_currentPoint.x - 2;
   translate.y -= m_currentPoint.y - 2 - m_center;
@@ -1559,8 +1558,8 @@ bool EditorCell::IsPointInSelection(wxDC& dc, wxPoint point)
   while (m_text.GetChar(positionOfCaret) != '\n' && positionOfCaret < (signed)m_text.Length())
   {
     s = m_text.SubString(lineStart, positionOfCaret);
-    dc.GetTextExtent(m_text.SubString(lineStart, positionOfCaret),
-                                      &width, &height);
+    FontCache::GetTextExtent(dc, m_text.SubString(lineStart, positionOfCaret),
+                             &width, &height);
     if (width > translate.x)
       break;
     positionOfCaret++;
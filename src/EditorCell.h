@@ -30,6 +30,9 @@ class EditorCell : public MathCell
 public:
   EditorCell();
   ~EditorCell();
+  // Not pooled, the input lives as long as its group
+  static void *operator new(size_t size) { return ::operator new(size); }
+  static void operator delete(void *p) { ::operator delete(p); }
   void Destroy();
   MathCell* Copy(bool all);
   void RecalculateSize(CellParser& parser, int fontsize, bool all);
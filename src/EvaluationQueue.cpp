@@ -20,27 +20,8 @@
 
 #include "EvaluationQueue.h"
 
-EvaluationQueueElement::EvaluationQueueElement(GroupCell* gr)
-{
-  group = gr;
-  next = NULL;
-}
-
 EvaluationQueue::EvaluationQueue()
 {
-  m_queue = NULL;
-  m_last = NULL;
-}
-
-bool EvaluationQueue::IsInQueue(GroupCell* gr)
-{
-  EvaluationQueueElement* tmp = m_queue;
-  while (tmp != NULL) {
-    if (tmp->group == gr)
-      return true;
-    tmp = tmp->next;
-  }
-  return false;
 }
 
 void EvaluationQueue::AddToQueue(GroupCell* gr)
@@ -48,13 +29,8 @@ void EvaluationQueue::AddToQueue(GroupCell* gr)
   if (gr->GetGroupType() != GC_TYPE_CODE
       || gr->GetEditable() == NULL) // dont add cells which can't be evaluated
     return;
-  EvaluationQueueElement* newelement = new EvaluationQueueElement(gr);
-  if (m_last == NULL)
-    m_queue = m_last = newelement;
-  else {
-    m_last->next = newelement;
-    m_last = newelement;
-  }
+  m_queue.push_back(gr);
+  gr->m_queued++;
 }
 
 /**
@@ -76,22 +52,49 @@ void EvaluationQueue::AddHiddenTreeToQueue(GroupCell* gr)
 
 void EvaluationQueue::RemoveFirst()
 {
-  if (m_queue == NULL)
+  if (m_queue.empty())
     return; // shouldn't happen
-  EvaluationQueueElement* tmp = m_queue;
-  if (m_queue == m_last) {
-    m_queue = m_last = NULL;
-  }
-  else
-    m_queue = m_queue->next;
+  m_queue.front()->m_queued--;
+  m_queue.pop_front();
+}
 
-  delete tmp;
+/**
+ * Removes gr from the queue, but only at positions from and after. The
+ * groups before from are already sent to maxima. Returns false if gr was
+ * not removed.
+ */
+bool EvaluationQueue::Remove(GroupCell* gr, size_t from)
+{
+  bool removed = false;
+  size_t i = from;
+  while (IsInQueue(gr) && i < m_queue.size())
+  {
+    if (m_queue[i] == gr) {
+      m_queue.erase(m_queue.begin() + i);
+      gr->m_queued--;
+      removed = true;
+    }
+    else
+      i++;
+  }
+  return removed;
 }
 
 GroupCell* EvaluationQueue::GetFirst()
 {
-  if (m_queue != NULL)
-    return m_queue->group;
+  if (!m_queue.empty())
+    return m_queue.front();
   else
     return NULL; // queu is empty
 }
+
+/**
+ * Returns the group at position index (0 is the first), NULL if the queue
+ * is shorter.
+ */
+GroupCell* EvaluationQueue::GetAt(int index)
+{
+  if (index >= 0 && (size_t)index < m_queue.size())
+    return m_queue[index];
+  return NULL;
+}
@@ -24,32 +24,28 @@
 
 #include "GroupCell.h"
 
-class EvaluationQueueElement {
-  public:
-    EvaluationQueueElement(GroupCell* gr);
-    ~EvaluationQueueElement() {
-    }
-    GroupCell* group;
-    EvaluationQueueElement* next;
-};
+#include <deque>
 
-// A simple FIFO queue with manual removal of elements
+// A simple FIFO queue with manual removal of elements. Every group counts
+// how often it is in the queue, so IsInQueue doesn't have to search it.
 class EvaluationQueue
 {
   public:
     EvaluationQueue();
     ~EvaluationQueue() {};
 
-    bool IsInQueue(GroupCell* gr);
+    bool IsInQueue(GroupCell* gr) { return gr != NULL && gr->m_queued > 0; }
 
     void AddToQueue(GroupCell* gr);
     void AddHiddenTreeToQueue(GroupCell* gr);
     void RemoveFirst();
+    bool Remove(GroupCell* gr, size_t from);
     GroupCell* GetFirst();
-    bool Empty() { return m_queue == NULL; }
+    GroupCell* GetAt(int index);
+    size_t Size() { return m_queue.size(); }
+    bool Empty() { return m_queue.empty(); }
   private:
-    EvaluationQueueElement* m_queue;
-    EvaluationQueueElement* m_last;
+    std::deque<GroupCell*> m_queue;
 };
 
 
@@ -38,8 +38,7 @@ ExptCell::~ExptCell()
     delete m_baseCell;
   if (m_powCell != NULL)
     delete m_powCell;
-  if (m_next != NULL)
-    delete m_next;
+  DeleteNext();
   delete m_exp;
   delete m_open;
   delete m_close;
@@ -59,14 +58,22 @@ void ExptCell::SetParent(MathCell *parent, bool all)
   MathCell::SetParent(parent, all);
 }
 
+void ExptCell::GetInnerCells(std::vector<MathCell*>& cells)
+{
+  cells.push_back(m_baseCell);
+  cells.push_back(m_powCell);
+  cells.push_back(m_open);
+  cells.push_back(m_close);
+}
+
 MathCell* ExptCell::Copy(bool all)
 {
   ExptCell* tmp = new ExptCell;
   CopyData(this, tmp);
   tmp->SetBase(m_baseCell->Copy(true));
   tmp->SetPower(m_powCell->Copy(true));
-  if (all && m_next != NULL)
-    tmp->AppendCell(m_next->Copy(all));
+  if (all)
+    CopyNext(tmp);
   return tmp;
 }
 
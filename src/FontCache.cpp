@@ -0,0 +1,140 @@
+///
+///  Copyright (C) 2013 The wxMaxima team
+///
+///  This program is free software; you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation; either version 2 of the License, or
+///  (at your option) any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program; if not, write to the Free Software
+///  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+///
+
+
+#include "FontCache.h"
+
+std::map<FontCache::Key, wxFont> FontCache::m_fonts;
+std::map<const wxObjectRefData*, int> FontCache::m_ids;
+std::list<FontCache::Extent> FontCache::m_extents;
+std::map<FontCache::ExtentKey, std::list<FontCache::Extent>::iterator> FontCache::m_extentIndex;
+long FontCache::m_created = 0;
+long FontCache::m_hits = 0;
+long FontCache::m_misses = 0;
+
+bool FontCache::Key::operator<(const Key& other) const
+{
+  if (size != other.size)
+    return size < other.size;
+  if (family != other.family)
+    return family < other.family;
+  if (style != other.style)
+    return style < other.style;
+  if (weight != other.weight)
+    return weight < other.weight;
+  if (underlined != other.underlined)
+    return underlined < other.underlined;
+  if (encoding != other.encoding)
+    return encoding < other.encoding;
+  return face < other.face;
+}
+
+bool FontCache::ExtentKey::operator<(const ExtentKey& other) const
+{
+  if (font != other.font)
+    return font < other.font;
+  if (ppi != other.ppi)
+    return ppi < other.ppi;
+  if (scaleX != other.scaleX)
+    return scaleX < other.scaleX;
+  if (scaleY != other.scaleY)
+    return scaleY < other.scaleY;
+  return text < other.text;
+}
+
+const wxFont& FontCache::Get(int size, int family, int style, int weight,
+                             bool underlined, const wxString& face,
+                             wxFontEncoding encoding)
+{
+  Key key;
+  key.size = size;
+  key.family = family;
+  key.style = style;
+  key.weight = weight;
+  key.underlined = underlined;
+  key.face = face;
+  key.encoding = encoding;
+
+  std::map<Key, wxFont>::iterator it = m_fonts.find(key);
+  if (it != m_fonts.end())
+    return it->second;
+
+  m_created++;
+  wxFont& font = m_fonts[key] = wxFont(size, family, style, weight, underlined,
+                                       face, encoding);
+  int id = m_ids.size() + 1;
+  m_ids[font.GetRefData()] = id;
+  return font;
+}
+
+/***
+ * Same as dc.GetTextExtent(text, width, height). Texts drawn with a font
+ * which doesn't come from the cache are always measured.
+ */
+void FontCache::GetTextExtent(wxDC& dc, const wxString& text,
+                              wxCoord *width, wxCoord *height)
+{
+  std::map<const wxObjectRefData*, int>::iterator id =
+    m_ids.find(dc.GetFont().GetRefData());
+  if (id == m_ids.end())
+  {
+    dc.GetTextExtent(text, width, height);
+    return;
+  }
+
+  ExtentKey key;
+  key.font = id->second;
+  key.ppi = dc.GetPPI().y;
+  dc.GetUserScale(&key.scaleX, &key.scaleY);
+  key.text = text;
+
+  std::map<ExtentKey, std::list<Extent>::iterator>::iterator it =
+    m_extentIndex.find(key);
+  if (it != m_extentIndex.end())
+  {
+    m_hits++;
+    m_extents.splice(m_extents.begin(), m_extents, it->second);
+    *width = it->second->width;
+    *height = it->second->height;
+    return;
+  }
+
+  m_misses++;
+  Extent extent;
+  extent.key = key;
+  dc.GetTextExtent(text, &extent.width, &extent.height);
+  *width = extent.width;
+  *height = extent.height;
+
+  m_extents.push_front(extent);
+  m_extentIndex[key] = m_extents.begin();
+  if (m_extents.size() > EXTENT_CACHE_SIZE)
+  {
+    m_extentIndex.erase(m_extents.back().key);
+    m_extents.pop_back();
+  }
+}
+
+void FontCache::Clear()
+{
+  m_extentIndex.clear();
+  m_extents.clear();
+  m_ids.clear();
+  m_fonts.clear();
+}
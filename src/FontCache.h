@@ -0,0 +1,88 @@
+///
+///  Copyright (C) 2013 The wxMaxima team
+///
+///  This program is free software; you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation; either version 2 of the License, or
+///  (at your option) any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program; if not, write to the Free Software
+///  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+///
+
+
+#ifndef _FONTCACHE_H_
+#define _FONTCACHE_H_
+
+#include <wx/wx.h>
+
+#include <map>
+#include <list>
+
+#define EXTENT_CACHE_SIZE 50000  // text extents kept by FontCache
+
+/***
+ * FontCache keeps the fonts used to draw the cells. Creating a wxFont is
+ * expensive on some platforms (on GTK it looks up a pango font
+ * description), and the cells set their font for every measure and draw.
+ *
+ * It also remembers the extents of the texts measured with these fonts,
+ * so that a relayout measures only new texts. Extents are kept per font,
+ * resolution and user scale of the dc, since a printout scaled to the
+ * page measures in other units. The least recently used extents
+ * are dropped when there are more than EXTENT_CACHE_SIZE.
+ *
+ * Clear has to be called when the styles or the zoom change.
+ */
+class FontCache
+{
+public:
+  static const wxFont& Get(int size, int family, int style, int weight,
+                           bool underlined, const wxString& face,
+                           wxFontEncoding encoding = wxFONTENCODING_DEFAULT);
+  static void GetTextExtent(wxDC& dc, const wxString& text,
+                            wxCoord *width, wxCoord *height);
+  static void Clear();
+  static long GetCount() { return m_fonts.size(); }
+  static long GetCreated() { return m_created; }
+  static long GetExtentHits() { return m_hits; }
+  static long GetExtentMisses() { return m_misses; }
+private:
+  struct Key
+  {
+    int size, family, style, weight;
+    bool underlined;
+    wxString face;
+    wxFontEncoding encoding;
+    bool operator<(const Key& other) const;
+  };
+  struct ExtentKey
+  {
+    int font;        // id of the font in m_ids
+    int ppi;         // printers measure in their own resolution
+    double scaleX;   // the user scale of the dc (zoomed printouts)
+    double scaleY;
+    wxString text;
+    bool operator<(const ExtentKey& other) const;
+  };
+  struct Extent
+  {
+    ExtentKey key;
+    wxCoord width, height;
+  };
+  static std::map<Key, wxFont> m_fonts;
+  static std::map<const wxObjectRefData*, int> m_ids;
+  static std::list<Extent> m_extents;  // most recently used first
+  static std::map<ExtentKey, std::list<Extent>::iterator> m_extentIndex;
+  static long m_created;
+  static long m_hits, m_misses;
+};
+
+#endif // _FONTCACHE_H_
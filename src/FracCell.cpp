@@ -54,6 +54,16 @@ void FracCell::SetParent(MathCell *parent, bool all)
   MathCell::SetParent(parent, all);
 }
 
+void FracCell::GetInnerCells(std::vector<MathCell*>& cells)
+{
+  cells.push_back(m_num);
+  cells.push_back(m_denom);
+  cells.push_back(m_open1);
+  cells.push_back(m_close1);
+  cells.push_back(m_open2);
+  cells.push_back(m_close2);
+}
+
 MathCell* FracCell::Copy(bool all)
 {
   FracCell* tmp = new FracCell;
@@ -63,8 +73,8 @@ MathCell* FracCell::Copy(bool all)
   tmp->m_fracStyle = m_fracStyle;
   tmp->m_exponent = m_exponent;
   tmp->SetupBreakUps();
-  if (all && m_next != NULL)
-    tmp->AppendCell(m_next->Copy(all));
+  if (all)
+    CopyNext(tmp);
   return tmp;
 }
 
@@ -74,8 +84,7 @@ FracCell::~FracCell()
     delete m_num;
   if (m_denom != NULL)
     delete m_denom;
-  if (m_next != NULL)
-    delete m_next;
+  DeleteNext();
 }
 
 void FracCell::Destroy()
@@ -131,10 +140,10 @@ void FracCell::RecalculateWidths(CellParser& parser, int fontsize, bool all)
     wxDC& dc = parser.GetDC();
     int height;
     int fontsize1 = (int) ((double)(fontsize) * scale + 0.5);
-    dc.SetFont(wxFont(fontsize1, wxFONTFAMILY_MODERN,
-                            false, false, false,
-                            parser.GetFontName(TS_VARIABLE)));
-    dc.GetTextExtent(wxT("/"), &m_expDivideWidth, &height);
+    dc.SetFont(FontCache::Get(fontsize1, wxFONTFAMILY_MODERN,
+                              false, false, false,
+                              parser.GetFontName(TS_VARIABLE)));
+    FontCache::GetTextExtent(dc, wxT("/"), &m_expDivideWidth, &height);
     m_width = m_num->GetFullWidth(scale) + m_denom->GetFullWidth(scale) + m_expDivideWidth;
   }
   else
@@ -203,9 +212,9 @@ void FracCell::Draw(CellParser& parser, wxPoint point, int fontsize, bool all)
       m_denom->Draw(parser, denom, fontsize, true);
 
       int fontsize1 = (int) ((double)(fontsize) * scale + 0.5);
-      dc.SetFont(wxFont(fontsize1, wxFONTFAMILY_MODERN,
-                              false, false, false,
-                              parser.GetFontName(TS_VARIABLE)));
+      dc.SetFont(FontCache::Get(fontsize1, wxFONTFAMILY_MODERN,
+                                false, false, false,
+                                parser.GetFontName(TS_VARIABLE)));
       dc.DrawText(wxT("/"),
                   point.x + m_num->GetFullWidth(scale),
                   point.y - m_num->GetMaxCenter() + SCALE_PX(MC_TEXT_PADDING, scale));
@@ -57,6 +57,7 @@ public:
   void SetupBreakUps();
   void Unbreak(bool all);
   void SetParent(MathCell *parent, bool all);
+  void GetInnerCells(std::vector<MathCell*>& cells);
 protected:
   MathCell *m_num;
   MathCell *m_denom;
@@ -31,8 +31,7 @@ FunCell::~FunCell()
     delete m_nameCell;
   if (m_argCell != NULL)
     delete m_argCell;
-  if (m_next != NULL)
-    delete m_next;
+  DeleteNext();
 }
 
 void FunCell::SetParent(MathCell *parent, bool all)
@@ -45,14 +44,20 @@ void FunCell::SetParent(MathCell *parent, bool all)
   MathCell::SetParent(parent, all);
 }
 
+void FunCell::GetInnerCells(std::vector<MathCell*>& cells)
+{
+  cells.push_back(m_nameCell);
+  cells.push_back(m_argCell);
+}
+
 MathCell* FunCell::Copy(bool all)
 {
   FunCell* tmp = new FunCell;
   CopyData(this, tmp);
   tmp->SetName(m_nameCell->Copy(true));
   tmp->SetArg(m_argCell->Copy(true));
-  if (all && m_next != NULL)
-    tmp->AppendCell(m_next->Copy(true));
+  if (all)
+    CopyNext(tmp);
   return tmp;
 }
 
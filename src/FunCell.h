@@ -41,6 +41,7 @@ public:
   bool BreakUp();
   void Unbreak(bool all);
   void SetParent(MathCell *parent, bool all);
+  void GetInnerCells(std::vector<MathCell*>& cells);
 protected:
   MathCell *m_nameCell;
   MathCell *m_argCell;
@@ -27,6 +27,7 @@
 #include "EditorCell.h"
 #include "ImgCell.h"
 #include "Bitmap.h"
+#include "OutputCache.h"
 
 GroupCell::GroupCell(int groupType, wxString initString) : MathCell()
 {
@@ -34,6 +35,7 @@ GroupCell::GroupCell(int groupType, wxString initString) : MathCell()
   m_output = NULL;
   m_hiddenTree = NULL;
   m_hiddenTreeParent = NULL;
+  m_queued = 0;
   m_outputRect.x = -1;
   m_outputRect.y = -1;
   m_outputRect.width = 0;
@@ -45,6 +47,7 @@ GroupCell::GroupCell(int groupType, wxString initString) : MathCell()
   m_indent = MC_GROUP_LEFT_INDENT;
   m_hide = false;
   m_working = false;
+  m_stale = false;
   m_groupType = groupType;
   m_lastInOutput = NULL;
   m_appendedCells = NULL;
@@ -119,6 +122,7 @@ GroupCell::GroupCell(int groupType, wxString initString) : MathCell()
 
 GroupCell::~GroupCell()
 {
+  OutputCache::Remove(this);
   if (m_input != NULL)
     delete m_input;
   DestroyOutput();
@@ -138,8 +142,16 @@ void GroupCell::SetParent(MathCell *parent, bool all)
   }
 }
 
+void GroupCell::GetInnerCells(std::vector<MathCell*>& cells)
+{
+  cells.push_back(m_input);
+  cells.push_back(m_output);
+  cells.push_back(m_hiddenTree);
+}
+
 void GroupCell::DestroyOutput()
 {
+  OutputCache::Remove(this);
   MathCell *tmp = m_output, *tmp1;
   while (tmp != NULL) {
     tmp1 = tmp;
@@ -176,8 +188,8 @@ MathCell* GroupCell::Copy(bool all)
     tmp->SetInput(m_input->Copy(true));
   if (m_output != NULL)
     tmp->SetOutput(m_output->Copy(true));
-  if (all && m_next != NULL)
-    tmp->AppendCell(m_next->Copy(all));
+  if (all)
+    CopyNext(tmp);
   return tmp;
 }
 
@@ -284,10 +296,65 @@ void GroupCell::AppendOutput(MathCell *cell)
     m_appendedCells = cell;
 }
 
+/***
+ * Inserts the list cells into the output before the cell before, which
+ * must not be the first cell of the output.
+ */
+void GroupCell::InsertOutput(MathCell *before, MathCell *cells)
+{
+  MathCell *previous = before->m_previous;
+  if (previous == NULL || cells == NULL)
+    return;
+
+  MathCell *last = cells;
+  while (last->m_next != NULL)
+    last = last->m_next;
+
+  MathCell *tmp = cells;
+  while (tmp != NULL) {
+    tmp->SetParent(this, false);
+    tmp = tmp->m_next;
+  }
+
+  previous->m_next = previous->m_nextToDraw = cells;
+  cells->m_previous = cells->m_previousToDraw = previous;
+  last->m_next = last->m_nextToDraw = before;
+  before->m_previous = before->m_previousToDraw = last;
+
+  ResetSize();
+}
+
+/***
+ * Removes cell (not the first one) from the output and deletes it.
+ */
+void GroupCell::RemoveOutputCell(MathCell *cell)
+{
+  MathCell *previous = cell->m_previous;
+  if (previous == NULL)
+    return;
+
+  previous->m_next = previous->m_nextToDraw = cell->m_next;
+  if (cell->m_next != NULL)
+    cell->m_next->m_previous = cell->m_next->m_previousToDraw = previous;
+
+  if (m_lastInOutput == cell)
+    m_lastInOutput = previous;
+  if (m_appendedCells == cell)
+    m_appendedCells = cell->m_next;
+
+  cell->m_next = NULL;
+  cell->Destroy();
+  delete cell;
+
+  ResetSize();
+}
+
 void GroupCell::Recalculate(CellParser& parser, int d_fontsize, int m_fontsize)
 {
   m_fontSize = d_fontsize;
   m_mathFontSize = m_fontsize;
+  if (parser.ForceUpdate())
+    m_stale = false;
 
   RecalculateWidths(parser, d_fontsize, false);
   RecalculateSize(parser, d_fontsize, false);
@@ -297,6 +364,8 @@ void GroupCell::RecalculateWidths(CellParser& parser, int fontsize, bool all)
 {
   if (m_width == -1 || m_height == -1 || parser.ForceUpdate())
   {
+    OutputCache::Remove(this);
+
     // special case of 'line cell'
     if (m_groupType == GC_TYPE_PAGEBREAK) {
       m_width = 10;
@@ -429,6 +498,20 @@ void GroupCell::RecalculateAppended(CellParser& parser)
   }
 
   m_appendedCells = NULL;
+  ResetData();
+  OutputCache::Remove(this);
+}
+
+/***
+ * Moves the group to point. The output moves with it, so a group which was
+ * only pushed up or down by the groups above does not need to be measured
+ * again.
+ */
+void GroupCell::SetCurrentPoint(wxPoint point)
+{
+  m_outputRect.x += point.x - m_currentPoint.x;
+  m_outputRect.y += point.y - m_currentPoint.y;
+  m_currentPoint = point;
 }
 
 void GroupCell::Draw(CellParser& parser, wxPoint point, int fontsize, bool all)
@@ -479,42 +562,12 @@ void GroupCell::Draw(CellParser& parser, wxPoint point, int fontsize, bool all)
       parser.Outdated(((EditorCell *)(m_input->m_next))->ContainsChanges());
 
     if (m_output != NULL && !m_hide) {
-      MathCell *tmp = m_output;
-      int drop = tmp->GetMaxDrop();
       in.y += m_input->GetMaxDrop() + m_output->GetMaxCenter();
       m_outputRect.y = in.y - m_output->GetMaxCenter();
       m_outputRect.x = in.x;
 
-      while (tmp != NULL) {
-
-        if (!tmp->m_isBroken) {
-          tmp->m_currentPoint.x = in.x;
-          tmp->m_currentPoint.y = in.y;
-          if (tmp->DrawThisCell(parser, in))
-            tmp->Draw(parser, in, MAX(tmp->IsMath() ? m_mathFontSize : m_fontSize, MC_MIN_SIZE), false);
-          if (tmp->m_nextToDraw != NULL) {
-            if (tmp->m_nextToDraw->BreakLineHere()) {
-              in.x = m_indent;
-              in.y += drop + tmp->m_nextToDraw->GetMaxCenter();
-              if (tmp->m_bigSkip)
-                in.y += MC_LINE_SKIP;
-              drop = tmp->m_nextToDraw->GetMaxDrop();
-            } else
-              in.x += (tmp->GetWidth() + MC_CELL_SKIP);
-          }
-
-        } else {
-          if (tmp->m_nextToDraw != NULL && tmp->m_nextToDraw->BreakLineHere()) {
-            in.x = m_indent;
-            in.y += drop + tmp->m_nextToDraw->GetMaxCenter();
-            if (tmp->m_bigSkip)
-              in.y += MC_LINE_SKIP;
-            drop = tmp->m_nextToDraw->GetMaxDrop();
-          }
-        }
-
-        tmp = tmp->m_nextToDraw;
-      }
+      if (!parser.CacheOutput() || !DrawCachedOutput(parser, in))
+        DrawOutput(parser, in);
     }
 
     parser.Outdated(false);
@@ -576,6 +629,98 @@ void GroupCell::Draw(CellParser& parser, wxPoint point, int fontsize, bool all)
   MathCell::Draw(parser, point, fontsize, all);
 }
 
+/***
+ * Draws the output cells, the first line at in.
+ */
+void GroupCell::DrawOutput(CellParser& parser, wxPoint in)
+{
+  MathCell *tmp = m_output;
+  int drop = tmp->GetMaxDrop();
+
+  while (tmp != NULL) {
+
+    if (!tmp->m_isBroken) {
+      tmp->m_currentPoint.x = in.x;
+      tmp->m_currentPoint.y = in.y;
+      if (tmp->DrawThisCell(parser, in))
+        tmp->Draw(parser, in, MAX(tmp->IsMath() ? m_mathFontSize : m_fontSize, MC_MIN_SIZE), false);
+      if (tmp->m_nextToDraw != NULL) {
+        if (tmp->m_nextToDraw->BreakLineHere()) {
+          in.x = m_indent;
+          in.y += drop + tmp->m_nextToDraw->GetMaxCenter();
+          if (tmp->m_bigSkip)
+            in.y += MC_LINE_SKIP;
+          drop = tmp->m_nextToDraw->GetMaxDrop();
+        } else
+          in.x += (tmp->GetWidth() + MC_CELL_SKIP);
+      }
+
+    } else {
+      if (tmp->m_nextToDraw != NULL && tmp->m_nextToDraw->BreakLineHere()) {
+        in.x = m_indent;
+        in.y += drop + tmp->m_nextToDraw->GetMaxCenter();
+        if (tmp->m_bigSkip)
+          in.y += MC_LINE_SKIP;
+        drop = tmp->m_nextToDraw->GetMaxDrop();
+      }
+    }
+
+    tmp = tmp->m_nextToDraw;
+  }
+}
+
+/***
+ * Draws the output from a bitmap in OutputCache, which is rendered first if
+ * needed. The bitmap is masked with the background of the dc, so that the
+ * brackets and the background drawn before show through it.
+ *
+ * Returns false if the output can not be cached: it is too large, or has
+ * cells which change by themselves (animations, editors in the output).
+ */
+bool GroupCell::DrawCachedOutput(CellParser& parser, wxPoint in)
+{
+  wxRect rect = m_outputRect;
+  rect.Inflate(MC_CELL_SKIP);
+  if (rect.width <= 0 || rect.height <= 0 ||
+      rect.height > OUTPUT_CACHE_MAX_HEIGHT ||
+      long(rect.width) * rect.height * 4 > OUTPUT_CACHE_SIZE / 8)
+    return false;
+
+  for (MathCell *tmp = m_output; tmp != NULL; tmp = tmp->m_next)
+    if (tmp->GetType() == MC_TYPE_SLIDE || tmp->GetType() == MC_TYPE_INPUT)
+      return false;
+
+  wxDC& dc = parser.GetDC();
+  wxPoint origin = rect.GetPosition();
+  wxBitmap *bitmap = OutputCache::Get(this, origin, parser.IsOutdated());
+
+  if (bitmap == NULL) {
+    wxColour background = dc.GetBackground().GetColour();
+    bitmap = new wxBitmap(rect.width, rect.height);
+
+    wxMemoryDC dcm;
+    dcm.SelectObject(*bitmap);
+    dcm.SetBackground(*(wxTheBrushList->FindOrCreateBrush(background, wxSOLID)));
+    dcm.Clear();
+    dcm.SetDeviceOrigin(-origin.x, -origin.y);
+    dcm.SetMapMode(wxMM_TEXT);
+    dcm.SetBackgroundMode(wxTRANSPARENT);
+    dcm.SetLogicalFunction(wxCOPY);
+
+    CellParser bitmapParser(parser, dcm);
+    bitmapParser.SetBounds(-1, -1);
+    SetPen(bitmapParser);
+    DrawOutput(bitmapParser, in);
+    dcm.SelectObject(wxNullBitmap);
+
+    bitmap->SetMask(new wxMask(*bitmap, background));
+    OutputCache::Add(this, bitmap, origin, parser.IsOutdated());
+  }
+
+  dc.DrawBitmap(*bitmap, origin.x, origin.y, true);
+  return true;
+}
+
 wxRect GroupCell::HideRect()
 {
   return wxRect(m_currentPoint.x - 10, m_currentPoint.y - m_center, 10, 10);
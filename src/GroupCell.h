@@ -42,11 +42,15 @@ class GroupCell: public MathCell
 public:
   GroupCell(int groupType, wxString initString = wxEmptyString);
   ~GroupCell();
+  // Not pooled, groups live as long as the document
+  static void *operator new(size_t size) { return ::operator new(size); }
+  static void operator delete(void *p) { ::operator delete(p); }
   MathCell* Copy(bool all);
   void Destroy();
   // general methods
   int GetGroupType() { return m_groupType; }
   void SetParent(MathCell *parent, bool all); // setting parent for all mathcells in GC
+  void GetInnerCells(std::vector<MathCell*>& cells);
   void SetWorking(bool working) { m_working = working; }
   // selection methods
   void SelectInner(wxRect& rect, MathCell** first, MathCell** last);
@@ -58,6 +62,8 @@ public:
   bool SetEditableContent(wxString text);
   EditorCell* GetEditable(); // returns pointer to editor (if there is one)
   void AppendOutput(MathCell *cell);
+  void InsertOutput(MathCell *before, MathCell *cells);
+  void RemoveOutputCell(MathCell *cell);
   void RemoveOutput();
   // exporting
   wxString ToTeX(bool all, wxString imgDir, wxString filename, int *imgCounter);
@@ -82,6 +88,12 @@ public:
   void RecalculateSize(CellParser& parser, int fontsize, bool all);
   void RecalculateWidths(CellParser& parser, int fontsize, bool all);
   void Recalculate(CellParser& parser, int d_fontsize, int m_fontsize);
+  // ResetSize marks the group for the next Recalculate
+  bool NeedsRecalculation() { return m_width == -1 || m_height == -1; }
+  void SetCurrentPoint(wxPoint point);
+  // measured for another width or zoom factor, waits for a forced Recalculate
+  bool IsStale() { return m_stale; }
+  void MarkStale() { m_stale = true; }
   void BreakUpCells(CellParser parser, int fontsize, int clientWidth);
   void BreakUpCells(MathCell *cell, CellParser parser, int fontsize, int clientWidth);
   void UnBreakUpCells();
@@ -106,6 +118,9 @@ public:
   void Number(int &section, int &subsection, int &image);
   void RecalculateAppended(CellParser& parser);
   void Draw(CellParser& parser, wxPoint point, int fontsize, bool all);
+  void DrawOutput(CellParser& parser, wxPoint in);
+  bool DrawCachedOutput(CellParser& parser, wxPoint in);
+  int m_queued; // how often this group is in the EvaluationQueue
 protected:
   GroupCell *m_hiddenTree; // here hidden (folded) tree of GCs is stored
   GroupCell *m_hiddenTreeParent; // store linkage to the parent of the fold
@@ -114,6 +129,7 @@ protected:
   MathCell *m_input, *m_output;
   bool m_hide;
   bool m_working;
+  bool m_stale;
   int m_indent;
   int m_fontSize;
   int m_mathFontSize;
@@ -50,8 +50,7 @@ ImgCell::~ImgCell()
 {
   if (m_bitmap != NULL)
     delete m_bitmap;
-  if (m_next != NULL)
-    delete m_next;
+  DeleteNext();
 }
 
 void ImgCell::LoadImage(wxString image, bool remove)
@@ -134,8 +133,8 @@ MathCell* ImgCell::Copy(bool all)
 
   tmp->m_bitmap = new wxBitmap(*m_bitmap);
 
-  if (all && m_next != NULL)
-    tmp->AppendCell(m_next->Copy(all));
+  if (all)
+    CopyNext(tmp);
 
   return tmp;
 }
@@ -0,0 +1,267 @@
+///
+///  Copyright (C) 2013 The wxMaxima team
+///
+///  This program is free software; you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation; either version 2 of the License, or
+///  (at your option) any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program; if not, write to the Free Software
+///  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+///
+
+#include "InputPreprocessor.h"
+
+#include <wx/tokenzr.h>
+
+#if wxUSE_UNICODE
+/***
+ * Maxima syntax for unicode characters which can be typed in the document.
+ */
+static const wxChar *Substitution(wxChar c)
+{
+  switch (c)
+  {
+  case 0x00B2: return wxT("^2");
+  case 0x00B3: return wxT("^3");
+  case 0x00BD: return wxT("(1/2)");
+  case 0x221A: return wxT("sqrt");
+  case 0x03C0: return wxT("%pi");
+  case 0x2148: return wxT("%i");
+  case 0x2147: return wxT("%e");
+  case 0x221E: return wxT("inf");
+  case 0x22C0: return wxT(" and ");
+  case 0x22C1: return wxT(" or ");
+  case 0x22BB: return wxT(" xor ");
+  case 0x22BC: return wxT(" nand ");
+  case 0x22BD: return wxT(" nor ");
+  case 0x21D2: return wxT(" implies ");
+  case 0x21D4: return wxT(" equiv ");
+  case 0x00AC: return wxT(" not ");
+  case 0x2212: return wxT("-");
+  }
+  return NULL;
+}
+#endif
+
+InputPreprocessor::InputPreprocessor()
+{
+}
+
+bool InputPreprocessor::IsNameChar(wxChar c)
+{
+  return wxIsalnum(c) || c == wxT('%') || c == wxT('_');
+}
+
+bool InputPreprocessor::IsArgChar(wxChar c)
+{
+  return IsNameChar(c) || c == wxT(',') || c == wxT('[') || c == wxT(']') ||
+         c == wxT(' ');
+}
+
+void InputPreprocessor::Process(const wxString& input, bool history)
+{
+  m_output.Empty();
+  m_output.Alloc(input.Length() + 1);
+  m_history.Empty();
+  if (history)
+    m_history.Alloc(input.Length());
+  m_symbols.Empty();
+  m_templates.Empty();
+
+  int state = STATE_CODE;
+  int depth = 0;               // comments can be nested
+  size_t statementStart = 0;   // start of the current statement in m_output
+  bool blank = true;           // the statement has only whitespace and comments
+
+  wxString::const_iterator end = input.end();
+  for (wxString::const_iterator it = input.begin(); it != end; ++it)
+  {
+    wxChar c = *it;
+    wxChar next = 0;
+    wxString::const_iterator n = it;
+    if (++n != end)
+      next = *n;
+
+    switch (state)
+    {
+    case STATE_CODE:
+      if (c == wxT(';') || c == wxT('$'))
+      {
+        if (blank)
+        {
+          // Maxima needs a statement to answer with a prompt, so a command
+          // with only blank statements is sent as ";"
+          m_output.Truncate(statementStart);
+          if (statementStart == 0)
+            m_output += c;
+        }
+        else
+        {
+          m_output += c;
+          FindDefinition(statementStart);
+        }
+        if (history)
+          m_history += c;
+        statementStart = m_output.Length();
+        blank = true;
+        continue;
+      }
+      if (c == wxT('/') && next == wxT('*'))
+      {
+        state = STATE_COMMENT;
+        depth = 1;
+        m_output += wxT("/*");
+        if (history)
+          m_history += wxT("/*");
+        ++it;
+        continue;
+      }
+      if (c == wxT('"'))
+        state = STATE_STRING;
+      else if (c == wxT('\\'))
+        state = STATE_ESCAPE;
+#if wxUSE_UNICODE
+      else if (c > 0x7F)
+      {
+        const wxChar *sub = Substitution(c);
+        if (sub != NULL)
+        {
+          m_output += sub;
+          if (history)
+            m_history += sub;
+          blank = false;
+          continue;
+        }
+      }
+#endif
+      if (!wxIsspace(c))
+        blank = false;
+      break;
+
+    case STATE_ESCAPE:
+      state = STATE_CODE;
+      break;
+
+    case STATE_STRING:
+      if (c == wxT('\\'))
+        state = STATE_STRING_ESCAPE;
+      else if (c == wxT('"'))
+        state = STATE_CODE;
+      break;
+
+    case STATE_STRING_ESCAPE:
+      state = STATE_STRING;
+      break;
+
+    case STATE_COMMENT:
+      if (c == wxT('*') && next == wxT('/'))
+      {
+        if (--depth == 0)
+          state = STATE_CODE;
+        m_output += wxT("*/");
+        if (history)
+          m_history += wxT("*/");
+        ++it;
+        continue;
+      }
+      if (c == wxT('/') && next == wxT('*'))
+      {
+        depth++;
+        m_output += wxT("/*");
+        if (history)
+          m_history += wxT("/*");
+        ++it;
+        continue;
+      }
+      break;
+    }
+
+    if (c == wxT('\n'))
+      m_output += wxT(' ');
+    else
+      m_output += c;
+    if (history)
+      m_history += c;
+  }
+
+  if (!blank)
+    FindDefinition(statementStart);
+
+  m_output += wxT('\n');
+}
+
+/***
+ * Looks for "name:" and "name(args):=" at the start of the statement which
+ * starts at start in m_output.
+ */
+void InputPreprocessor::FindDefinition(size_t start)
+{
+  size_t end = m_output.Length();
+  size_t i = start;
+
+  while (i < end && m_output[i] == wxT(' '))
+    i++;
+  size_t nameStart = i;
+  while (i < end && IsNameChar(m_output[i]))
+    i++;
+  if (i == nameStart)
+    return;
+  wxString name = m_output.Mid(nameStart, i - nameStart);
+
+  while (i < end && m_output[i] == wxT(' '))
+    i++;
+  if (i == end)
+    return;
+
+  // Variable definition
+  if (m_output[i] == wxT(':'))
+  {
+    m_symbols.Add(name);
+    return;
+  }
+
+  // Function definition
+  if (m_output[i] != wxT('('))
+    return;
+  size_t argsStart = ++i;
+  while (i < end && IsArgChar(m_output[i]))
+    i++;
+  if (i == end || m_output[i] != wxT(')'))
+    return;
+  wxString args = m_output.Mid(argsStart, i - argsStart);
+  i++;
+  while (i < end && m_output[i] == wxT(' '))
+    i++;
+  if (i + 1 >= end || m_output[i] != wxT(':') || m_output[i + 1] != wxT('='))
+    return;
+
+  m_symbols.Add(name);
+
+  /// Create a template from the input
+  wxString templ = name + wxT("(");
+  wxStringTokenizer argTokens(args, wxT(","));
+  int count = 0;
+  while (argTokens.HasMoreTokens()) {
+    if (count > 0)
+      templ << wxT(",");
+    wxString a = argTokens.GetNextToken().Trim().Trim(false);
+    if (a != wxEmptyString)
+    {
+      if (a[0]=='[')
+        templ << wxT("[<") << a.SubString(1, a.Length()-2) << wxT(">]");
+      else
+        templ << wxT("<") << a << wxT(">");
+      count++;
+    }
+  }
+  templ << wxT(")");
+  m_templates.Add(templ);
+}
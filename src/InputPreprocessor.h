@@ -0,0 +1,65 @@
+///
+///  Copyright (C) 2013 The wxMaxima team
+///
+///  This program is free software; you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation; either version 2 of the License, or
+///  (at your option) any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program; if not, write to the Free Software
+///  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+///
+
+#ifndef _INPUTPREPROCESSOR_H_
+#define _INPUTPREPROCESSOR_H_
+
+#include <wx/wx.h>
+#include <wx/arrstr.h>
+
+/***
+ * InputPreprocessor prepares a command before it is sent to maxima. In a
+ * single pass over the text it
+ *  - replaces unicode operators (pi, sqrt, ...) with maxima syntax,
+ *  - joins the lines,
+ *  - drops statements which contain only whitespace and comments (a
+ *    command which has only such statements becomes ";"),
+ *  - finds variable and function definitions for autocompletion.
+ * Strings and comments are copied unchanged and their contents never
+ * end a statement.
+ */
+class InputPreprocessor
+{
+public:
+  InputPreprocessor();
+  void Process(const wxString& input, bool history);
+  // The command as a single line, ending with a newline
+  const wxString& GetOutput() { return m_output; }
+  // The command with substitutions, but not joined (only if history was set)
+  const wxString& GetHistory() { return m_history; }
+  const wxArrayString& GetSymbols() { return m_symbols; }
+  const wxArrayString& GetTemplates() { return m_templates; }
+private:
+  enum {
+    STATE_CODE,
+    STATE_ESCAPE,     // after a backslash outside of strings
+    STATE_STRING,
+    STATE_STRING_ESCAPE,
+    STATE_COMMENT
+  };
+  void FindDefinition(size_t start);
+  static bool IsNameChar(wxChar c);
+  static bool IsArgChar(wxChar c);
+  wxString m_output;
+  wxString m_history;
+  wxArrayString m_symbols;
+  wxArrayString m_templates;
+};
+
+#endif // _INPUTPREPROCESSOR_H_
@@ -48,8 +48,7 @@ IntCell::~IntCell()
     delete m_over;
   if (m_var != NULL)
     delete m_var;
-  if (m_next != NULL)
-    delete m_next;
+  DeleteNext();
 }
 
 void IntCell::SetParent(MathCell *parent, bool all)
@@ -66,6 +65,14 @@ void IntCell::SetParent(MathCell *parent, bool all)
   MathCell::SetParent(parent, all);
 }
 
+void IntCell::GetInnerCells(std::vector<MathCell*>& cells)
+{
+  cells.push_back(m_base);
+  cells.push_back(m_under);
+  cells.push_back(m_over);
+  cells.push_back(m_var);
+}
+
 MathCell* IntCell::Copy(bool all)
 {
   IntCell *tmp = new IntCell;
@@ -75,8 +82,8 @@ MathCell* IntCell::Copy(bool all)
   tmp->SetOver(m_over->Copy(true));
   tmp->SetVar(m_var->Copy(true));
   tmp->m_intStyle = m_intStyle;
-  if (all && m_next != NULL)
-    tmp->AppendCell(m_next->Copy(all));
+  if (all)
+    CopyNext(tmp);
   return tmp;
 }
 
@@ -152,10 +159,10 @@ void IntCell::RecalculateWidths(CellParser& parser, int fontsize, bool all)
   if (parser.CheckTeXFonts()) {
     wxDC& dc = parser.GetDC();
     int fontsize1 = (int) ((fontsize * scale * 1.5 + 0.5));
-    dc.SetFont(wxFont(fontsize1, wxFONTFAMILY_MODERN,
-                      false, false, false,
-                      parser.GetTeXCMEX()));
-    dc.GetTextExtent(wxT("\x5A"), &m_signWidth, &m_signSize);
+    dc.SetFont(FontCache::Get(fontsize1, wxFONTFAMILY_MODERN,
+                              false, false, false,
+                              parser.GetTeXCMEX()));
+    FontCache::GetTextExtent(dc, wxT("\x5A"), &m_signWidth, &m_signSize);
 
 #if defined __WXMSW__
     m_signWidth = m_signWidth / 2;
@@ -173,10 +180,10 @@ void IntCell::RecalculateWidths(CellParser& parser, int fontsize, bool all)
 #if defined __WXMSW__
     wxDC& dc = parser.GetDC();
     int fontsize1 = (int) ((INTEGRAL_FONT_SIZE * scale + 0.5));
-    dc.SetFont(wxFont(fontsize1, wxFONTFAMILY_MODERN,
-                      false, false, false,
-                      parser.GetSymbolFontName()));
-    dc.GetTextExtent(wxT(INTEGRAL_TOP), &m_charWidth, &m_charHeight);
+    dc.SetFont(FontCache::Get(fontsize1, wxFONTFAMILY_MODERN,
+                              false, false, false,
+                              parser.GetSymbolFontName()));
+    FontCache::GetTextExtent(dc, wxT(INTEGRAL_TOP), &m_charWidth, &m_charHeight);
 
     m_width = m_signWidth +
               m_base->GetFullWidth(scale) +
@@ -247,9 +254,9 @@ void IntCell::Draw(CellParser& parser, wxPoint point, int fontsize, bool all)
     {
       SetForeground(parser);
       int fontsize1 = (int) ((fontsize * scale * 1.5 + 0.5));
-      dc.SetFont(wxFont(fontsize1, wxFONTFAMILY_MODERN,
-                        false, false, false,
-                        parser.GetTeXCMEX()));
+      dc.SetFont(FontCache::Get(fontsize1, wxFONTFAMILY_MODERN,
+                                false, false, false,
+                                parser.GetTeXCMEX()));
       dc.DrawText(wxT("\x5A"),
                   sign.x,
                   sign.y - m_signTop);
@@ -261,9 +268,9 @@ void IntCell::Draw(CellParser& parser, wxPoint point, int fontsize, bool all)
       int fontsize1 = (int) ((INTEGRAL_FONT_SIZE * scale + 0.5));
       int m_signWCenter = m_signWidth / 2;
 
-      dc.SetFont(wxFont(fontsize1, wxFONTFAMILY_MODERN,
-                        false, false, false,
-                        parser.GetSymbolFontName()));
+      dc.SetFont(FontCache::Get(fontsize1, wxFONTFAMILY_MODERN,
+                                false, false, false,
+                                parser.GetSymbolFontName()));
       dc.DrawText(wxT(INTEGRAL_TOP),
                   sign.x + m_signWCenter - m_charWidth / 2,
                   sign.y - (m_signSize + 1) / 2);
@@ -37,8 +37,7 @@ LimitCell::~LimitCell()
     delete m_under;
   if (m_name != NULL)
     delete m_name;
-  if (m_next != NULL)
-    delete m_next;
+  DeleteNext();
 }
 
 void LimitCell::SetParent(MathCell *parent, bool all)
@@ -53,6 +52,13 @@ void LimitCell::SetParent(MathCell *parent, bool all)
   MathCell::SetParent(parent, all);
 }
 
+void LimitCell::GetInnerCells(std::vector<MathCell*>& cells)
+{
+  cells.push_back(m_base);
+  cells.push_back(m_under);
+  cells.push_back(m_name);
+}
+
 MathCell* LimitCell::Copy(bool all)
 {
   LimitCell* tmp = new LimitCell;
@@ -60,8 +66,8 @@ MathCell* LimitCell::Copy(bool all)
   tmp->SetBase(m_base->Copy(true));
   tmp->SetUnder(m_under->Copy(true));
   tmp->SetName(m_name->Copy(true));
-  if (all && m_next != NULL)
-    tmp->AppendCell(m_next->Copy(true));
+  if (all)
+    CopyNext(tmp);
   return tmp;
 }
 
@@ -40,6 +40,7 @@ public:
 	wxString ToXML(bool all);	//new!!
   void SelectInner(wxRect& rect, MathCell** first, MathCell** last);
   void SetParent(MathCell *parent, bool all);
+  void GetInnerCells(std::vector<MathCell*>& cells);
 protected:
   MathCell *m_base;
   MathCell *m_under;
@@ -19,6 +19,8 @@
 
 #include "MathCell.h"
 
+#include <vector>
+
 MathCell::MathCell()
 {
   m_next = NULL;
@@ -89,12 +91,19 @@ void MathCell::SetType(int type)
 
 }
 
+/***
+ * The list functions below (SetParent, Draw, RecalculateWidths, ToString,
+ * ...) are called by the derived classes for this cell only after they
+ * handled it. With all they loop over the rest of the list and call the
+ * function of each cell with all=false, so that long lists do not recurse.
+ */
 void MathCell::SetParent(MathCell *parent, bool all)
 {
   m_group = parent;
 
-  if (m_next != NULL && all)
-    m_next->SetParent(parent, all);
+  if (all)
+    for (MathCell *tmp = m_next; tmp != NULL; tmp = tmp->m_next)
+      tmp->SetParent(parent, false);
 }
 
 /***
@@ -104,22 +113,69 @@ void MathCell::AppendCell(MathCell *p_next)
 {
   if (p_next == NULL)
     return ;
-  m_maxDrop = -1;
-  m_maxCenter = -1;
-  if (m_next == NULL)
+  MathCell *last = this;
+  last->m_maxDrop = -1;
+  last->m_maxCenter = -1;
+  while (last->m_next != NULL)
   {
-    m_next = p_next;
-    m_next->m_previous = this;
-    MathCell *tmp = this;
-    while (tmp->m_nextToDraw != NULL)
-      tmp = tmp->m_nextToDraw;
-    tmp->m_nextToDraw = p_next;
-    p_next->m_previousToDraw = tmp;
+    last = last->m_next;
+    last->m_maxDrop = -1;
+    last->m_maxCenter = -1;
   }
-  else
-    m_next->AppendCell(p_next);
+
+  last->m_next = p_next;
+  p_next->m_previous = last;
+  MathCell *tmp = last;
+  while (tmp->m_nextToDraw != NULL)
+    tmp = tmp->m_nextToDraw;
+  tmp->m_nextToDraw = p_next;
+  p_next->m_previousToDraw = tmp;
 };
 
+/***
+ * Appends copies of the cells after this one to copy, which is the copy of
+ * this cell.
+ */
+void MathCell::CopyNext(MathCell *copy)
+{
+  for (MathCell *tmp = m_next; tmp != NULL; tmp = tmp->m_next)
+  {
+    MathCell *next = tmp->Copy(false);
+    copy->AppendCell(next);
+    copy = next;
+  }
+}
+
+/***
+ * Deletes the cells after this one. The destructors of the derived classes
+ * call this instead of deleting m_next, which would recurse.
+ */
+void MathCell::DeleteNext()
+{
+  MathCell *tmp = m_next;
+  m_next = NULL;
+  while (tmp != NULL)
+  {
+    MathCell *next = tmp->m_next;
+    tmp->m_next = NULL;
+    delete tmp;
+    tmp = next;
+  }
+}
+
+void CellList::Append(MathCell *cells)
+{
+  if (cells == NULL)
+    return;
+  if (m_first == NULL)
+    m_first = cells;
+  else
+    m_last->AppendCell(cells);
+  m_last = cells;
+  while (m_last->m_next != NULL)
+    m_last = m_last->m_next;
+}
+
 
 /***
  * Get the pointer to the parent group cell
@@ -132,21 +188,37 @@ MathCell* MathCell::GetParent()
 
 /***
  * Get the maximum drop of the center.
+ *
+ * This is the maximum over the rest of the line. The cells up to the first
+ * known value are collected and computed from the end of the line back.
  */
 int MathCell::GetMaxCenter()
 {
   if (m_maxCenter == -1)
   {
-    int center = m_isBroken ? 0 : m_center;
-    if (m_nextToDraw == NULL)
-      m_maxCenter = center;
-    else
+    std::vector<MathCell*> line;
+    int rest = -1;
+    MathCell *tmp = this;
+    while (true)
     {
+      line.push_back(tmp);
+      MathCell *next = tmp->m_nextToDraw;
       // If the next cell is on a new line, maxCenter is m_center
-      if (m_nextToDraw->m_breakLine && !m_nextToDraw->m_isBroken)
-        m_maxCenter = center;
-      else
-        m_maxCenter = MAX(center, m_nextToDraw->GetMaxCenter());
+      if (next == NULL || (next->m_breakLine && !next->m_isBroken))
+        break;
+      if (next->m_maxCenter != -1)
+      {
+        rest = next->m_maxCenter;
+        break;
+      }
+      tmp = next;
+    }
+
+    for (size_t i = line.size(); i-- > 0;)
+    {
+      MathCell *cell = line[i];
+      cell->m_maxCenter = MAX(cell->m_isBroken ? 0 : cell->m_center, rest);
+      rest = cell->m_maxCenter;
     }
   }
   return m_maxCenter;
@@ -159,15 +231,28 @@ int MathCell::GetMaxDrop()
 {
   if (m_maxDrop == -1)
   {
-    int drop = m_isBroken ? 0 : (m_height - m_center);
-    if (m_nextToDraw == NULL)
-      m_maxDrop = drop;
-    else
+    std::vector<MathCell*> line;
+    int rest = -1;
+    MathCell *tmp = this;
+    while (true)
     {
-      if (m_nextToDraw->m_breakLine && !m_nextToDraw->m_isBroken)
-        m_maxDrop = drop;
-      else
-        m_maxDrop = MAX(drop, m_nextToDraw->GetMaxDrop());
+      line.push_back(tmp);
+      MathCell *next = tmp->m_nextToDraw;
+      if (next == NULL || (next->m_breakLine && !next->m_isBroken))
+        break;
+      if (next->m_maxDrop != -1)
+      {
+        rest = next->m_maxDrop;
+        break;
+      }
+      tmp = next;
+    }
+
+    for (size_t i = line.size(); i-- > 0;)
+    {
+      MathCell *cell = line[i];
+      cell->m_maxDrop = MAX(cell->m_isBroken ? 0 : (cell->m_height - cell->m_center), rest);
+      rest = cell->m_maxDrop;
     }
   }
   return m_maxDrop;
@@ -188,11 +273,23 @@ int MathCell::GetFullWidth(double scale)
 {
   if (m_fullWidth == -1)
   {
-    if (m_next == NULL)
-      m_fullWidth = m_width;
-    else
-      m_fullWidth = m_width + m_next->GetFullWidth(scale) +
-                    SCALE_PX(MC_CELL_SKIP, scale);
+    std::vector<MathCell*> cells;
+    MathCell *tmp = this;
+    while (tmp != NULL && tmp->m_fullWidth == -1)
+    {
+      cells.push_back(tmp);
+      tmp = tmp->m_next;
+    }
+
+    int rest = tmp == NULL ? 0 : tmp->m_fullWidth;
+    for (size_t i = cells.size(); i-- > 0;)
+    {
+      MathCell *cell = cells[i];
+      cell->m_fullWidth = cell->m_width;
+      if (cell->m_next != NULL)
+        cell->m_fullWidth += rest + SCALE_PX(MC_CELL_SKIP, scale);
+      rest = cell->m_fullWidth;
+    }
   }
   return m_fullWidth;
 }
@@ -202,15 +299,34 @@ int MathCell::GetFullWidth(double scale)
  */
 int MathCell::GetLineWidth(double scale)
 {
-  int width = m_isBroken ? 0 : m_width;
   if (m_lineWidth == -1)
   {
-    if (m_nextToDraw == NULL || m_nextToDraw->m_breakLine ||
-        m_nextToDraw->m_type == MC_TYPE_MAIN_PROMPT)
-      m_lineWidth = width;
-    else
-      m_lineWidth = width + m_nextToDraw->GetLineWidth(scale) +
-                    SCALE_PX(MC_CELL_SKIP, scale);
+    std::vector<MathCell*> line;
+    int rest = -1;
+    MathCell *tmp = this;
+    while (true)
+    {
+      line.push_back(tmp);
+      MathCell *next = tmp->m_nextToDraw;
+      if (next == NULL || next->m_breakLine ||
+          next->m_type == MC_TYPE_MAIN_PROMPT)
+        break;
+      if (next->m_lineWidth != -1)
+      {
+        rest = next->m_lineWidth;
+        break;
+      }
+      tmp = next;
+    }
+
+    for (size_t i = line.size(); i-- > 0;)
+    {
+      MathCell *cell = line[i];
+      cell->m_lineWidth = cell->m_isBroken ? 0 : cell->m_width;
+      if (rest != -1)
+        cell->m_lineWidth += rest + SCALE_PX(MC_CELL_SKIP, scale);
+      rest = cell->m_lineWidth;
+    }
   }
   return m_lineWidth;
 }
@@ -223,11 +339,16 @@ void MathCell::Draw(CellParser& parser, wxPoint point, int fontsize, bool all)
 {
   m_currentPoint.x = point.x;
   m_currentPoint.y = point.y;
-  if (m_nextToDraw != NULL && all)
+  if (all)
   {
     double scale = parser.GetScale();
-    point.x += m_width + SCALE_PX(MC_CELL_SKIP, scale);
-    m_nextToDraw->Draw(parser, point, fontsize, true);
+    MathCell *tmp = this;
+    while (tmp->m_nextToDraw != NULL)
+    {
+      point.x += tmp->m_width + SCALE_PX(MC_CELL_SKIP, scale);
+      tmp = tmp->m_nextToDraw;
+      tmp->Draw(parser, point, fontsize, false);
+    }
   }
 }
 
@@ -239,8 +360,9 @@ void MathCell::Draw(CellParser& parser, wxPoint point, int fontsize, bool all)
  */
 void MathCell::RecalculateSize(CellParser& parser, int fontsize, bool all)
 {
-  if (m_next != NULL && all)
-    m_next->RecalculateSize(parser, fontsize, all);
+  if (all)
+    for (MathCell *tmp = m_next; tmp != NULL; tmp = tmp->m_next)
+      tmp->RecalculateSize(parser, fontsize, false);
 }
 
 /***
@@ -252,8 +374,9 @@ void MathCell::RecalculateSize(CellParser& parser, int fontsize, bool all)
 void MathCell::RecalculateWidths(CellParser& parser, int fontsize, bool all)
 {
   ResetData();
-  if (m_next != NULL && all)
-    m_next->RecalculateWidths(parser, fontsize, all);
+  if (all)
+    for (MathCell *tmp = m_next; tmp != NULL; tmp = tmp->m_next)
+      tmp->RecalculateWidths(parser, fontsize, false);
 }
 
 /***
@@ -302,11 +425,10 @@ void MathCell::DrawBoundingBox(wxDC& dc, bool all, int border)
  */
 bool MathCell::IsCompound()
 {
-  if (IsOperator())
-    return true;
-  if (m_next == NULL)
-    return false;
-  return m_next->IsCompound();
+  for (MathCell *tmp = this; tmp != NULL; tmp = tmp->m_next)
+    if (tmp->IsOperator())
+      return true;
+  return false;
 }
 
 /***
@@ -322,29 +444,35 @@ bool MathCell::IsOperator()
  */
 wxString MathCell::ToString(bool all)
 {
-  if (all && m_next != NULL) {
-    if (m_next->ForceBreakLineHere())
-      return wxT("\n") + m_next->ToString(all);
-    return m_next->ToString(all);
-  }
-  return wxEmptyString;
+  wxString str;
+  if (all)
+    for (MathCell *tmp = m_next; tmp != NULL; tmp = tmp->m_next) {
+      if (tmp->ForceBreakLineHere())
+        str += wxT("\n");
+      str += tmp->ToString(false);
+    }
+  return str;
 }
 
 wxString MathCell::ToTeX(bool all)
 {
-  if (all && m_next != NULL)
-    return m_next->ToTeX(all);
-  return wxEmptyString;
+  wxString str;
+  if (all)
+    for (MathCell *tmp = m_next; tmp != NULL; tmp = tmp->m_next)
+      str += tmp->ToTeX(false);
+  return str;
 }
 
 wxString MathCell::ToXML(bool all)
 {
-  if (all && m_next != NULL) {
-    if (m_next->ForceBreakLineHere())
-      return wxT("</mth>\n<mth>") + m_next->ToXML(all);
-    return m_next->ToXML(all);
-  }
-  return wxEmptyString;
+  wxString str;
+  if (all)
+    for (MathCell *tmp = m_next; tmp != NULL; tmp = tmp->m_next) {
+      if (tmp->ForceBreakLineHere())
+        str += wxT("</mth>\n<mth>");
+      str += tmp->ToXML(false);
+    }
+  return str;
 }
 
 /***
@@ -377,12 +505,10 @@ void MathCell::SelectRect(wxRect& rect, MathCell** first, MathCell** last)
  */
 void MathCell::SelectFirst(wxRect& rect, MathCell** first)
 {
-  if (rect.Intersects(GetRect(false)))
-    *first = this;
-  else if (m_nextToDraw != NULL)
-    m_nextToDraw->SelectFirst(rect, first);
-  else
-    *first = NULL;
+  MathCell *tmp = this;
+  while (tmp != NULL && !rect.Intersects(tmp->GetRect(false)))
+    tmp = tmp->m_nextToDraw;
+  *first = tmp;
 }
 
 /***
@@ -390,10 +516,9 @@ void MathCell::SelectFirst(wxRect& rect, MathCell** first)
  */
 void MathCell::SelectLast(wxRect& rect, MathCell** last)
 {
-  if (rect.Intersects(GetRect(false)))
-    *last = this;
-  if (m_nextToDraw != NULL)
-    m_nextToDraw->SelectLast(rect, last);
+  for (MathCell *tmp = this; tmp != NULL; tmp = tmp->m_nextToDraw)
+    if (rect.Intersects(tmp->GetRect(false)))
+      *last = tmp;
 }
 
 /***
@@ -451,8 +576,9 @@ void MathCell::Unbreak(bool all)
   m_nextToDraw = m_next;
   if (m_nextToDraw != NULL)
     m_nextToDraw->m_previousToDraw = this;
-  if (all && m_next != NULL)
-    m_next->Unbreak(all);
+  if (all)
+    for (MathCell *tmp = m_next; tmp != NULL; tmp = tmp->m_next)
+      tmp->Unbreak(false);
 }
 
 /***
@@ -44,7 +44,9 @@
 #endif
 
 #include <wx/wx.h>
+#include <vector>
 #include "CellParser.h"
+#include "CellPool.h"
 #include "TextStyle.h"
 
 enum {
@@ -71,6 +73,10 @@ public:
   virtual MathCell* Copy(bool all) = 0;
   virtual void Destroy() = 0;
 
+  // Output cells are allocated from the CellPool
+  static void *operator new(size_t size) { return CellPool::Allocate(size); }
+  static void operator delete(void *p, size_t size) { CellPool::Free(p, size); }
+
   void AppendCell(MathCell *p_next);
 
   void BreakLine(bool breakLine) { m_breakLine = breakLine; }
@@ -176,10 +182,14 @@ public:
   void SetForeground(CellParser& parser);
   virtual bool IsActive() { return false; }
   virtual void SetParent(MathCell *parent, bool all);
+  // Adds the first cells of the lists inside this cell (may add NULL)
+  virtual void GetInnerCells(std::vector<MathCell*>& cells) { }
   void SetStyle(int style) { m_textStyle = style; }
   bool IsMath();
   void SetAltCopyText(wxString text) { m_altCopyText = text; }
 protected:
+  void CopyNext(MathCell *copy);
+  void DeleteNext();
   int m_height;
   int m_width;
   int m_fullWidth;
@@ -196,4 +206,20 @@ protected:
   wxString m_altCopyText; // m_altCopyText is not check in all cells!
 };
 
+/***
+ * A list of cells which knows its last cell, so that building a list does
+ * not walk it for each new cell. Only the cached sizes of the last cell
+ * are reset when a cell is appended, the list is not measured yet.
+ */
+class CellList
+{
+public:
+  CellList() { m_first = m_last = NULL; }
+  void Append(MathCell *cells);
+  MathCell *GetFirst() { return m_first; }
+  MathCell *GetLast() { return m_last; }
+private:
+  MathCell *m_first, *m_last;
+};
+
 #endif //_MATHCELL_H_
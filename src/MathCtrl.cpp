@@ -28,6 +28,21 @@
 #include "GroupCell.h"
 #include "SlideShowCell.h"
 #include "ImgCell.h"
+#include "FracCell.h"
+#include "ExptCell.h"
+#include "SubCell.h"
+#include "SubSupCell.h"
+#include "ParenCell.h"
+#include "FunCell.h"
+#include "SqrtCell.h"
+#include "AbsCell.h"
+#include "AtCell.h"
+#include "DiffCell.h"
+#include "IntCell.h"
+#include "LimitCell.h"
+#include "SumCell.h"
+#include "MatrCell.h"
+#include "SharedCell.h"
 
 #include <wx/clipbrd.h>
 #include <wx/config.h>
@@ -41,9 +56,17 @@
 #include <wx/filesys.h>
 #include <wx/fs_mem.h>
 
+#include <algorithm>
+#include <iterator>
+#include <typeinfo>
+#include <set>
+
 #define SCROLL_UNIT 10
 #define CARET_TIMER_TIMEOUT 500
 #define ANIMATION_TIMER_TIMEOUT 300
+#define OUTPUT_TIMER_TIMEOUT 16     // lay out new output at most once per frame
+#define RELAYOUT_SLICE 20           // ms spent on stale groups per idle event
+#define FLASH_TIMER_TIMEOUT 250     // how long repainted parts are flashed
 #define AC_MENU_LENGTH 25
 
 void AddLineToFile(wxTextFile& output, wxString s, bool unicode = true);
@@ -52,7 +75,18 @@ enum
 {
   TIMER_ID,
   CARET_TIMER_ID,
-  ANIMATION_TIMER_ID
+  ANIMATION_TIMER_ID,
+  OUTPUT_TIMER_ID,
+  FLASH_TIMER_ID
+};
+
+enum
+{
+  DECORATION_SELECTION,
+  DECORATION_HCARET,
+  DECORATION_ACTIVE,
+  DECORATION_QUEUE,
+  DECORATION_QUEUE_FIRST
 };
 
 MathCtrl::MathCtrl(wxWindow* parent, int id, wxPoint position, wxSize size) :
@@ -65,7 +99,6 @@ MathCtrl::MathCtrl(wxWindow* parent, int id, wxPoint position, wxSize size) :
   )
 {
   m_tree = NULL;
-  m_memory = NULL;
   m_selectionStart = NULL;
   m_selectionEnd = NULL;
   m_clickType = CLICK_TYPE_NONE;
@@ -83,6 +116,15 @@ MathCtrl::MathCtrl(wxWindow* parent, int id, wxPoint position, wxSize size) :
   m_timer.SetOwner(this, TIMER_ID);
   m_caretTimer.SetOwner(this, CARET_TIMER_ID);
   m_animationTimer.SetOwner(this, ANIMATION_TIMER_ID);
+  m_outputTimer.SetOwner(this, OUTPUT_TIMER_ID);
+  m_flashTimer.SetOwner(this, FLASH_TIMER_ID);
+  m_decorationsValid = false;
+  m_flashRepaints = false;
+  m_outputGroup = m_outputScroll = NULL;
+  m_outputLines = m_outputFlushes = m_groupsMeasured = 0;
+  m_groupIndexValid = false;
+  m_relayoutPending = false;
+  m_relayoutNext = 0;
   m_animate = false;
   m_workingGroup = NULL;
   m_saved = true;
@@ -97,48 +139,282 @@ MathCtrl::MathCtrl(wxWindow* parent, int id, wxPoint position, wxSize size) :
 MathCtrl::~MathCtrl() {
   if (m_tree != NULL)
     DestroyTree();
-  if (m_memory != NULL)
-    delete m_memory;
 
   delete m_evaluationQueue;
 }
 
 /***
  * Redraw the control
+ *
+ * The update region is copied from the tiles of m_tiles, and only the
+ * tiles which are not cached are rendered (DrawTile).
  */
 void MathCtrl::OnPaint(wxPaintEvent& event) {
   wxPaintDC dc(this);
 
-  wxMemoryDC dcm;
+  // New output has to be laid out before it is drawn, and so do the
+  // stale groups in the window
+  FlushOutput(false);
+  RecalculateVisible();
 
-  // Get the font size
-  wxConfig *config = (wxConfig *)wxConfig::Get();
+  // Remember the decorations drawn after a Refresh of the whole window
+  if (!m_decorationsValid) {
+    GetDecorations(m_decorations);
+    m_decorationsValid = true;
+  }
 
   // Prepare data
   wxRect rect = GetUpdateRegion().GetBox();
   //printf("Updating rect [%d, %d] -> [%d, %d]\n", rect.x, rect.y, rect.width, rect.height);
-  wxSize sz = GetSize();
-  int tmp, top, bottom, drop;
-  CalcUnscrolledPosition(0, rect.GetTop(), &tmp, &top);
-  CalcUnscrolledPosition(0, rect.GetBottom(), &tmp, &bottom);
-
-  // Thest if m_memory is NULL (resize event)
-  if (m_memory == NULL)
-    m_memory = new wxBitmap(sz.x, sz.y);
+  int left, top, right, bottom;
+  CalcUnscrolledPosition(rect.GetLeft(), rect.GetTop(), &left, &top);
+  CalcUnscrolledPosition(rect.GetRight(), rect.GetBottom(), &right, &bottom);
+  wxRect update(wxPoint(left, top), wxPoint(right, bottom));
 
-  // Prepare memory DC
   wxString bgColStr= wxT("white");
-  config->Read(wxT("Style/Background/color"), &bgColStr);
+  wxConfig::Get()->Read(wxT("Style/Background/color"), &bgColStr);
   SetBackgroundColour(wxColour(bgColStr));
 
-  dcm.SelectObject(*m_memory);
+  wxMemoryDC dcm;
+  for (int y = MAX(top, 0) / TILE_HEIGHT; y <= bottom / TILE_HEIGHT; y++)
+    for (int x = MAX(left, 0) / TILE_WIDTH; x <= right / TILE_WIDTH; x++)
+    {
+      wxBitmap *tile = m_tiles.Get(x, y);
+      if (tile == NULL)
+      {
+        tile = m_tiles.Add(x, y);
+        DrawTile(*tile, x, y);
+      }
+
+      wxRect part(x * TILE_WIDTH, y * TILE_HEIGHT, TILE_WIDTH, TILE_HEIGHT);
+      part.Intersect(update);
+      int windowX, windowY;
+      CalcScrolledPosition(part.x, part.y, &windowX, &windowY);
+      dcm.SelectObject(*tile);
+      dc.Blit(windowX, windowY, part.width, part.height, &dcm,
+              part.x - x * TILE_WIDTH, part.y - y * TILE_HEIGHT);
+      dcm.SelectObject(wxNullBitmap);
+    }
+
+  // Hatch the repainted parts, except for the repaints which clear the
+  // hatching again (m_unflash)
+  if (m_flashRepaints)
+  {
+    int dx, dy;
+    CalcUnscrolledPosition(0, 0, &dx, &dy);
+    wxRegion repainted(GetUpdateRegion());
+    repainted.Offset(dx, dy);
+    wxRegion flash(repainted);
+    flash.Subtract(m_unflash);
+    m_unflash.Subtract(repainted);
+
+    if (!flash.IsEmpty())
+    {
+      dc.SetPen(*wxRED_PEN);
+      dc.SetBrush(*(wxTheBrushList->FindOrCreateBrush(*wxRED, wxCROSSDIAG_HATCH)));
+      wxRegionIterator it(flash);
+      while (it)
+      {
+        wxRect part = it.GetRect();
+        CalcScrolledPosition(part.x, part.y, &part.x, &part.y);
+        dc.DrawRectangle(part);
+        it++;
+      }
+      m_flashed.Union(flash);
+      if (!m_flashTimer.IsRunning())
+        m_flashTimer.Start(FLASH_TIMER_TIMEOUT, true);
+    }
+  }
+}
+
+bool MathCtrl::Decoration::operator<(const Decoration& other) const
+{
+  if (kind != other.kind)
+    return kind < other.kind;
+  if (rect.x != other.rect.x)
+    return rect.x < other.rect.x;
+  if (rect.y != other.rect.y)
+    return rect.y < other.rect.y;
+  if (rect.width != other.rect.width)
+    return rect.width < other.rect.width;
+  return rect.height < other.rect.height;
+}
+
+void MathCtrl::AddDecoration(std::vector<Decoration>& decorations, int kind, wxRect rect)
+{
+  Decoration decoration;
+  decoration.kind = kind;
+  decoration.rect = rect;
+  decorations.push_back(decoration);
+}
+
+/***
+ * Collects the rectangles (document coordinates) of the decorations as
+ * DrawTile and GroupCell::Draw draw them, sorted.
+ */
+void MathCtrl::GetDecorations(std::vector<Decoration>& decorations)
+{
+  decorations.clear();
+
+  if (m_selectionStart != NULL)
+  {
+    MathCell *tmp = m_selectionStart;
+    if (m_selectionStart->GetType() == MC_TYPE_GROUP)
+    {
+      while (tmp != NULL)
+      {
+        wxRect rect = tmp->GetRect();
+        AddDecoration(decorations, DECORATION_SELECTION,
+                      wxRect(0, rect.GetTop() - 3, MC_GROUP_LEFT_INDENT + 6, rect.GetHeight() + 7));
+        if (tmp == m_selectionEnd)
+          break;
+        tmp = tmp->m_next;
+      }
+    }
+    else
+    {
+      while (tmp != NULL)
+      {
+        if (!tmp->m_isBroken && !tmp->m_isHidden)
+        {
+          wxRect rect = tmp->GetRect();
+          rect.Inflate(6);
+          AddDecoration(decorations, DECORATION_SELECTION, rect);
+        }
+        if (tmp == m_selectionEnd)
+          break;
+        tmp = tmp->m_nextToDraw;
+      }
+    }
+  }
+
+  if (m_hCaretActive && m_hCaretPositionStart == NULL)
+  {
+    int caretY = 5;
+    if (m_hCaretPosition != NULL)
+      caretY = ((int) MC_GROUP_SKIP) / 2 + m_hCaretPosition->GetRect().GetBottom() + 1;
+    AddDecoration(decorations, DECORATION_HCARET, wxRect(0, caretY - 1, 3001, 3));
+  }
+
+  if (m_activeCell != NULL)
+  {
+    wxRect rect = m_activeCell->GetRect();
+    AddDecoration(decorations, DECORATION_ACTIVE,
+                  wxRect(0, rect.GetTop() - 2, GetVirtualSize().x, rect.GetHeight() + 4));
+    if (m_activeCell->GetParent() != NULL)
+    {
+      rect = m_activeCell->GetParent()->GetRect();
+      AddDecoration(decorations, DECORATION_ACTIVE,
+                    wxRect(0, rect.GetTop() - 3, MC_GROUP_LEFT_INDENT + 6, rect.GetHeight() + 7));
+    }
+  }
+
+  for (size_t i = 0; i < m_evaluationQueue->Size(); i++)
+  {
+    wxRect rect = m_evaluationQueue->GetAt(i)->GetRect();
+    AddDecoration(decorations, i == 0 ? DECORATION_QUEUE_FIRST : DECORATION_QUEUE,
+                  wxRect(0, rect.GetTop() - 3, MC_GROUP_LEFT_INDENT + 6, rect.GetHeight() + 7));
+  }
+
+  std::sort(decorations.begin(), decorations.end());
+}
+
+/***
+ * Repaints the decorations which changed since they were drawn and the
+ * row of the active cell. This is the Refresh for changes of the
+ * selection, the carets, the active cell and the evaluation queue;
+ * changes of the layout are damaged by UpdateGroupIndex.
+ */
+void MathCtrl::RefreshView()
+{
+  std::vector<Decoration> decorations;
+  GetDecorations(decorations);
+
+  // The caret and the selection in the editor
+  if (m_activeCell != NULL)
+  {
+    wxRect rect = m_activeCell->GetRect();
+    Damage(wxRect(0, rect.GetTop() - 2, GetVirtualSize().x, rect.GetHeight() + 4));
+  }
+
+  // After a Refresh of the whole window everything is drawn again anyway
+  if (m_decorationsValid)
+  {
+    std::vector<Decoration> changed;
+    std::set_symmetric_difference(m_decorations.begin(), m_decorations.end(),
+                                  decorations.begin(), decorations.end(),
+                                  std::back_inserter(changed));
+    for (size_t i = 0; i < changed.size(); i++)
+      Damage(changed[i].rect);
+  }
+
+  m_decorations.swap(decorations);
+  m_decorationsValid = true;
+}
+
+/***
+ * Marks rect (document coordinates) to be repainted. Its tiles are dropped
+ * at once, the window is refreshed in FlushDamage, so that all damage of
+ * one event is repainted together.
+ */
+void MathCtrl::Damage(const wxRect& rect)
+{
+  m_tiles.Invalidate(rect);
+  m_damage.Union(rect);
+}
+
+/***
+ * Marks everything at or below y to be repainted, after the groups there
+ * moved.
+ */
+void MathCtrl::DamageBelow(int y)
+{
+  m_tiles.InvalidateBelow(y);
+
+  int view_x, view_y, width, height;
+  GetViewStart(&view_x, &view_y);
+  GetClientSize(&width, &height);
+  int top = MAX(y, view_y * SCROLL_UNIT);
+  int bottom = view_y * SCROLL_UNIT + height;
+  if (top <= bottom)
+    m_damage.Union(wxRect(0, top, MAX(GetVirtualSize().x, width), bottom - top + 1));
+}
+
+void MathCtrl::FlushDamage()
+{
+  if (m_damage.IsEmpty())
+    return;
+
+  wxRegionIterator it(m_damage);
+  while (it)
+  {
+    wxRect rect = it.GetRect();
+    CalcScrolledPosition(rect.x, rect.y, &rect.x, &rect.y);
+    wxScrolledCanvas::Refresh(true, &rect);
+    it++;
+  }
+  m_damage.Clear();
+}
+
+/***
+ * Renders the tile (x, y) of the document into bitmap.
+ */
+void MathCtrl::DrawTile(wxBitmap& bitmap, int x, int y)
+{
+  int top = y * TILE_HEIGHT;
+  int bottom = top + TILE_HEIGHT - 1;
+
+  // Prepare memory DC
+  wxMemoryDC dcm;
+  dcm.SelectObject(bitmap);
   dcm.SetBackground(*(wxTheBrushList->FindOrCreateBrush(GetBackgroundColour(), wxSOLID)));
   dcm.Clear();
-  PrepareDC(dcm);
+  dcm.SetDeviceOrigin(-x * TILE_WIDTH, -top);
   dcm.SetMapMode(wxMM_TEXT);
   dcm.SetBackgroundMode(wxTRANSPARENT);
   dcm.SetLogicalFunction(wxCOPY);
 
+  wxConfig *config = (wxConfig *)wxConfig::Get();
   CellParser parser(dcm);
   parser.SetBounds(top, bottom);
   parser.SetZoomFactor(m_zoomFactor);
@@ -194,12 +470,15 @@ void MathCtrl::OnPaint(wxPaintEvent& event) {
     //
     // Mark groupcells currently in queue. TODO better in gc::draw?
     //
+    // the brackets reach a little into the skip between groups
+    size_t firstVisible = FindGroupBelow(top - MC_GROUP_SKIP);
+    size_t groups = m_groupIndex.size();
     if (m_evaluationQueue->GetFirst() != NULL) {
-      MathCell* tmp = m_tree;
       dcm.SetBrush(*wxTRANSPARENT_BRUSH);
-      while (tmp != NULL)
+      for (size_t i = firstVisible; i < groups && m_groupTop[i] <= bottom + MC_GROUP_SKIP; i++)
       {
-        if (m_evaluationQueue->IsInQueue(dynamic_cast<GroupCell*>(tmp))) {
+        GroupCell *tmp = m_groupIndex[i];
+        if (m_evaluationQueue->IsInQueue(tmp)) {
           if (m_evaluationQueue->GetFirst() == tmp)
           {
             wxRect rect = tmp->GetRect();
@@ -213,19 +492,11 @@ void MathCtrl::OnPaint(wxPaintEvent& event) {
             dcm.DrawRectangle( 3, rect.GetTop() - 2, MC_GROUP_LEFT_INDENT, rect.GetHeight() + 5);
           }
         }
-        tmp = tmp->m_next;
       }
     }
     //
-    // Draw content over
+    // Draw content over, only the groups in the update region
     //
-    wxPoint point;
-    point.x = MC_GROUP_LEFT_INDENT;
-    point.y = MC_BASE_INDENT + m_tree->GetMaxCenter();
-    // Draw tree
-    MathCell* tmp = m_tree;
-    drop = tmp->GetMaxDrop();
-
     dcm.SetPen(*(wxThePenList->FindOrCreatePen(parser.GetColor(TS_DEFAULT), 1, wxSOLID)));
     dcm.SetBrush(*(wxTheBrushList->FindOrCreateBrush(parser.GetColor(TS_DEFAULT))));
 
@@ -233,19 +504,19 @@ void MathCtrl::OnPaint(wxPaintEvent& event) {
     config->Read(wxT("changeAsterisk"), &changeAsterisk);
     parser.SetChangeAsterisk(changeAsterisk);
 
-    while (tmp != NULL)
+    // A selection in the output is drawn under the cells, so that output is
+    // not drawn from OutputCache
+    MathCell *selectedGroup = NULL;
+    if (m_selectionStart != NULL && m_selectionStart->GetType() != MC_TYPE_GROUP)
+      selectedGroup = m_selectionStart->GetParent();
+
+    for (size_t i = firstVisible; i < groups && m_groupTop[i] <= bottom + MC_GROUP_SKIP; i++)
     {
-      tmp->m_currentPoint.x = point.x;
-      tmp->m_currentPoint.y = point.y;
+      GroupCell *tmp = m_groupIndex[i];
+      wxPoint point = tmp->m_currentPoint;
+      parser.SetCacheOutput(tmp != selectedGroup);
       if (tmp->DrawThisCell(parser, point))
         tmp->Draw(parser, point, MAX(fontsize, MC_MIN_SIZE), false);
-      if (tmp->m_next != NULL) {
-        point.x = MC_GROUP_LEFT_INDENT;
-        point.y += drop + tmp->m_next->GetMaxCenter();
-        point.y += MC_GROUP_SKIP;
-        drop = tmp->m_next->GetMaxDrop();
-      }
-      tmp = tmp->m_next;
     }
 
   }
@@ -266,10 +537,7 @@ void MathCtrl::OnPaint(wxPaintEvent& event) {
 
   }
 
-  // Blit the memory image to the window
-  dcm.SetDeviceOrigin(0, 0);
-  dc.Blit(0, rect.GetTop(), sz.x, rect.GetBottom() - rect.GetTop() + 1, &dcm,
-      0, rect.GetTop());
+  dcm.SelectObject(wxNullBitmap);
 }
 
 // InsertGroupCells
@@ -296,6 +564,7 @@ GroupCell *MathCtrl::InsertGroupCells(GroupCell* tree, GroupCell* where)
   if (m_tree == NULL)
     where = NULL;
 
+  InvalidateGroupIndex();
   if (where)
     next = dynamic_cast<GroupCell*>(where->m_next);
   else {
@@ -357,13 +626,13 @@ void MathCtrl::InsertLine(MathCell *newCell, bool forceNewLine)
 
   newCell->ForceBreakLine(forceNewLine);
 
+  // Lay out the output of another group before adding to this one
+  if (m_outputGroup != NULL && m_outputGroup != tmp)
+    FlushOutput();
+
+  bool prompt = (newCell->GetType() == MC_TYPE_PROMPT);
+
   tmp->AppendOutput(newCell);
-  if (newCell->GetType() == MC_TYPE_PROMPT)
-  {
-    m_workingGroup = tmp;
-    ScrollToCell(tmp->GetParent());
-    OpenHCaret();
-  }
 
   while (newCell != NULL)
   {
@@ -374,19 +643,85 @@ void MathCtrl::InsertLine(MathCell *newCell, bool forceNewLine)
   m_selectionStart = NULL;
   m_selectionEnd = NULL;
 
+  m_outputLines++;
+  m_outputGroup = m_outputScroll = tmp;
+
+  // A question is shown at once, other output is laid out and displayed
+  // later together with the lines which arrive in the meantime.
+  if (prompt)
+  {
+    FlushOutput();
+    m_workingGroup = tmp;
+    ScrollToCell(tmp->GetParent());
+    OpenHCaret();
+  }
+  else if (!m_outputTimer.IsRunning())
+    m_outputTimer.Start(OUTPUT_TIMER_TIMEOUT, true);
+}
+
+/***
+ * Displays the next part of a long output in place of more.
+ */
+void MathCtrl::ShowMore(MoreCell *more)
+{
+  GroupCell *group = dynamic_cast<GroupCell*>(more->GetParent());
+  if (group == NULL)
+    return;
+
+  FlushOutput(false);
+  m_selectionStart = m_selectionEnd = NULL;
+  m_clickType = CLICK_TYPE_NONE;
+
+  wxBeginBusyCursor();
+  group->InsertOutput(more, more->ParseNext());
+  if (more->IsDone())
+    group->RemoveOutputCell(more);
+  wxEndBusyCursor();
+
+  Recalculate();
+  Refresh();
+}
+
+/***
+ * Lays out the output inserted by InsertLine since the last call. With
+ * scroll == true the new output is scrolled into view and refreshed.
+ */
+void MathCtrl::FlushOutput(bool scroll)
+{
+  if (m_outputGroup == NULL)
+    return;
+
+  GroupCell *group = m_outputGroup;
+  m_outputGroup = NULL;
+  m_outputTimer.Stop();
+  m_outputFlushes++;
+
   wxClientDC dc(this);
   CellParser parser(dc);
   parser.SetZoomFactor(m_zoomFactor);
   parser.SetClientWidth(GetClientSize().GetWidth() - MC_GROUP_LEFT_INDENT - MC_BASE_INDENT);
 
-  tmp->RecalculateAppended(parser);
+  group->RecalculateAppended(parser);
   Recalculate();
 
-  ScrollToCell(tmp); // also refreshes
+  if (scroll)
+  {
+    m_outputScroll = NULL;
+    ScrollToCell(group); // also refreshes
+  }
+  else
+    // called from OnPaint, scroll on the next frame
+    m_outputTimer.Start(OUTPUT_TIMER_TIMEOUT, true);
 }
 
 /***
  * Recalculate dimensions of cells
+ *
+ * Without force only the groups which were reset (ResetSize) are measured
+ * again. The groups below the first changed group are then moved by
+ * UpdateGroupIndex. RecalculateForce measures every group and is needed
+ * when the styles change. For the window width and the zoom factor
+ * ScheduleRelayout does the same work in the background.
  */
 void MathCtrl::RecalculateForce() {
   Recalculate(true);
@@ -394,8 +729,6 @@ void MathCtrl::RecalculateForce() {
 
 void MathCtrl::Recalculate(bool force)
 {
-  GroupCell *tmp = m_tree;
-
   wxClientDC dc(this);
   CellParser parser(dc);
   parser.SetZoomFactor(m_zoomFactor);
@@ -404,35 +737,301 @@ void MathCtrl::Recalculate(bool force)
   int d_fontsize = parser.GetDefaultFontSize();
   int m_fontsize = parser.GetMathFontSize();
 
+  if (force || !m_groupIndexValid) {
+    GroupCell *tmp = m_tree;
+    while (tmp != NULL) {
+      if (force || tmp->NeedsRecalculation()) {
+        parser.SetForceUpdate(force || tmp->IsStale());
+        tmp->Recalculate(parser, d_fontsize, m_fontsize);
+        m_groupsMeasured++;
+      }
+      tmp = dynamic_cast<GroupCell*>(tmp->m_next);
+    }
+    UpdateGroupIndex();
+    if (force)
+      m_relayoutPending = false;
+  }
+
+  else {
+    // Groups can also change their size without being reset (appended
+    // output, or a reset group which was measured in Draw), so compare
+    // the sizes with the ones they were positioned with.
+    size_t groups = m_groupIndex.size();
+    size_t first = groups;
+    for (size_t i = 0; i < groups; i++) {
+      GroupCell *tmp = m_groupIndex[i];
+      if (tmp->NeedsRecalculation()) {
+        parser.SetForceUpdate(tmp->IsStale());
+        tmp->Recalculate(parser, d_fontsize, m_fontsize);
+        m_groupsMeasured++;
+        first = MIN(first, i);
+      }
+      else if (i < first && (tmp->GetMaxCenter() != m_groupCenter[i] ||
+                             tmp->GetMaxDrop() != m_groupDrop[i]))
+        first = i;
+    }
+    if (first < groups)
+      UpdateGroupIndex(first);
+  }
+
+  AdjustSize();
+}
+
+/***
+ * Positions the groups below each other and remembers where each group
+ * is, so that painting and hit testing can find the groups at some y
+ * with a binary search instead of going through the whole document.
+ * Has to be called when the size of a group changes (Recalculate does
+ * it). Functions which add or remove groups call InvalidateGroupIndex, and
+ * the index is then built again before it is used.
+ *
+ * If the index is valid, the groups above from stay where they are.
+ */
+void MathCtrl::UpdateGroupIndex(size_t from)
+{
   wxPoint point;
   point.x = MC_GROUP_LEFT_INDENT;
-  point.y = MC_BASE_INDENT ;
+  point.y = MC_BASE_INDENT;
+
+  int changedTop = 0;
+  if (!m_groupIndexValid || from == 0 || from >= m_groupIndex.size()) {
+    from = 0;
+    Refresh();
+    m_groupIndex.clear();
+    GroupCell *tmp = m_tree;
+    while (tmp != NULL) {
+      m_groupIndex.push_back(tmp);
+      tmp = dynamic_cast<GroupCell*>(tmp->m_next);
+    }
+    m_groupTop.resize(m_groupIndex.size());
+    m_groupBottom.resize(m_groupIndex.size());
+    m_groupCenter.resize(m_groupIndex.size());
+    m_groupDrop.resize(m_groupIndex.size());
+  }
+  else {
+    point.y = m_groupIndex[from - 1]->GetCurrentY() + m_groupDrop[from - 1] +
+              MC_GROUP_SKIP;
+    changedTop = m_groupTop[from];
+  }
+
+  for (size_t i = from; i < m_groupIndex.size(); i++) {
+    GroupCell *tmp = m_groupIndex[i];
+    m_groupCenter[i] = tmp->GetMaxCenter();
+    m_groupDrop[i] = tmp->GetMaxDrop();
+
+    point.y += m_groupCenter[i];
+    tmp->SetCurrentPoint(point);
+    point.y += m_groupDrop[i];
+
+    wxRect rect = tmp->GetRect();
+    m_groupTop[i] = MIN(rect.GetTop(), point.y - tmp->GetMaxHeight());
+    m_groupBottom[i] = MAX(rect.GetBottom(), point.y);
+
+    point.y += MC_GROUP_SKIP;
+  }
+
+  // The brackets and the horizontal caret reach into the skip above
+  if (from > 0)
+    DamageBelow(MIN(changedTop, m_groupTop[from]) - MC_GROUP_SKIP);
+
+  m_groupIndexHeight = point.y;
+  m_groupIndexWidth = MC_BASE_INDENT;
+  for (size_t i = 0; i < m_groupIndex.size(); i++)
+    m_groupIndexWidth = MAX(m_groupIndexWidth, 2*MC_BASE_INDENT + m_groupIndex[i]->GetWidth());
+
+  m_groupIndexValid = true;
+}
+
+/***
+ * Returns the position in m_groupIndex of the first group which ends at
+ * or below y, or m_groupIndex.size() if there is none.
+ */
+size_t MathCtrl::FindGroupBelow(int y)
+{
+  if (!m_groupIndexValid)
+    UpdateGroupIndex();
+  return std::lower_bound(m_groupBottom.begin(), m_groupBottom.end(), y) -
+         m_groupBottom.begin();
+}
 
+/***
+ * Lays out the document again after the width of the window or the zoom
+ * factor changed. Measuring every group at once takes seconds for a large
+ * document, so the groups are only marked stale. The groups in the window
+ * are measured now, the others keep their old size until OnIdle measures
+ * them, starting with the groups below the window.
+ */
+void MathCtrl::ScheduleRelayout()
+{
+  GroupCell *tmp = m_tree;
   while (tmp != NULL) {
-    tmp->Recalculate(parser, d_fontsize, m_fontsize);
-//    tmp->RecalculateWidths(parser, MAX(fontsize, MC_MIN_SIZE), false);
-//    tmp->RecalculateSize(parser, MAX(fontsize, MC_MIN_SIZE), false);
-    point.y += tmp->GetMaxCenter();
-    tmp->m_currentPoint.x = point.x;
-    tmp->m_currentPoint.y = point.y;
-    point.y += tmp->GetMaxDrop();
+    tmp->MarkStale();
     tmp = dynamic_cast<GroupCell*>(tmp->m_next);
-    point.y += MC_GROUP_SKIP;
   }
+  if (m_tree == NULL)
+    return;
 
+  m_relayoutPending = true;
+  RecalculateVisible();
+
+  int view_x, view_y;
+  GetViewStart(&view_x, &view_y);
+  m_relayoutNext = FindGroupBelow(view_y * SCROLL_UNIT);
   AdjustSize();
 }
 
+/***
+ * Measures the stale groups in the window, so that what is drawn is laid
+ * out for the current width and zoom factor. Measuring a group moves the
+ * groups below it, which can bring other stale groups into the window.
+ * Returns true if some group was measured.
+ */
+bool MathCtrl::RecalculateVisible()
+{
+  if (!m_relayoutPending || m_tree == NULL)
+    return false;
+
+  int view_x, view_y, width, height;
+  GetViewStart(&view_x, &view_y);
+  GetClientSize(&width, &height);
+  int top = view_y * SCROLL_UNIT;
+  int bottom = top + height;
+
+  wxClientDC dc(this);
+  CellParser parser(dc);
+  parser.SetZoomFactor(m_zoomFactor);
+  parser.SetForceUpdate(true);
+  parser.SetClientWidth(width - MC_GROUP_LEFT_INDENT - MC_BASE_INDENT);
+  int d_fontsize = parser.GetDefaultFontSize();
+  int m_fontsize = parser.GetMathFontSize();
+
+  bool measured = false;
+  for (;;) {
+    size_t i = FindGroupBelow(top - MC_GROUP_SKIP);
+    size_t groups = m_groupIndex.size();
+    size_t first = groups;
+    for (; i < groups && m_groupTop[i] <= bottom + MC_GROUP_SKIP; i++) {
+      GroupCell *tmp = m_groupIndex[i];
+      if (tmp->IsStale()) {
+        tmp->Recalculate(parser, d_fontsize, m_fontsize);
+        m_groupsMeasured++;
+        first = MIN(first, i);
+      }
+    }
+    if (first == groups)
+      break;
+    UpdateGroupIndex(first);
+    measured = true;
+  }
+
+  if (measured) {
+    AdjustSize();
+    // UpdateGroupIndex dropped the tiles, the window has to be drawn again
+    wxScrolledCanvas::Refresh();
+  }
+  return measured;
+}
+
+/***
+ * Measures stale groups for RELAYOUT_SLICE ms. The first group in the
+ * window keeps its place on the screen when the groups above it change
+ * their size, and the scrollbars follow the size of the document.
+ */
+void MathCtrl::OnIdle(wxIdleEvent& event)
+{
+  event.Skip();
+  FlushDamage();
+  if (!m_relayoutPending)
+    return;
+
+  if (!m_groupIndexValid)
+    UpdateGroupIndex();
+  size_t groups = m_groupIndex.size();
+  if (groups == 0) {
+    m_relayoutPending = false;
+    return;
+  }
+
+  int view_x, view_y, width, height;
+  GetViewStart(&view_x, &view_y);
+  GetClientSize(&width, &height);
+  size_t anchor = FindGroupBelow(view_y * SCROLL_UNIT);
+  int anchorY = 0;
+  if (anchor < groups)
+    anchorY = m_groupIndex[anchor]->GetCurrentY();
+
+  wxClientDC dc(this);
+  CellParser parser(dc);
+  parser.SetZoomFactor(m_zoomFactor);
+  parser.SetForceUpdate(true);
+  parser.SetClientWidth(width - MC_GROUP_LEFT_INDENT - MC_BASE_INDENT);
+  int d_fontsize = parser.GetDefaultFontSize();
+  int m_fontsize = parser.GetMathFontSize();
+
+  wxLongLong start = wxGetLocalTimeMillis();
+  size_t first = groups;
+  size_t scanned = 0;
+  if (m_relayoutNext >= groups)
+    m_relayoutNext = 0;
+  while (scanned < groups) {
+    size_t i = m_relayoutNext;
+    m_relayoutNext = (i + 1) % groups;
+    scanned++;
+    GroupCell *tmp = m_groupIndex[i];
+    if (tmp->IsStale()) {
+      tmp->Recalculate(parser, d_fontsize, m_fontsize);
+      m_groupsMeasured++;
+      first = MIN(first, i);
+      if (wxGetLocalTimeMillis() - start >= RELAYOUT_SLICE)
+        break;
+    }
+  }
+  // A whole round without running out of time leaves no stale groups
+  if (scanned == groups)
+    m_relayoutPending = false;
+
+  if (first < groups) {
+    UpdateGroupIndex(first);
+    AdjustSize();
+    if (anchor < groups && first < anchor) {
+      int y = view_y * SCROLL_UNIT + m_groupIndex[anchor]->GetCurrentY() - anchorY;
+      Scroll(-1, (MAX(y, 0) + SCROLL_UNIT / 2) / SCROLL_UNIT);
+    }
+    if (m_groupTop[first] <= view_y * SCROLL_UNIT + height)
+      wxScrolledCanvas::Refresh();
+  }
+
+  if (m_relayoutPending)
+    event.RequestMore();
+}
+
+/***
+ * Drops the tiles in rect (window coordinates) or all tiles, and redraws.
+ * RefreshRect calls this too.
+ */
+void MathCtrl::Refresh(bool eraseBackground, const wxRect *rect)
+{
+  if (rect == NULL) {
+    m_tiles.Clear();
+    m_damage.Clear();
+    m_decorationsValid = false;
+  }
+  else {
+    wxRect document(*rect);
+    CalcUnscrolledPosition(document.x, document.y, &document.x, &document.y);
+    m_tiles.Invalidate(document);
+  }
+  wxScrolledCanvas::Refresh(eraseBackground, rect);
+}
+
 /***
  * Resize the control
  */
 void MathCtrl::OnSize(wxSizeEvent& event) {
-  wxDELETE(m_memory);
-
   if (m_tree != NULL) {
     m_selectionStart = NULL;
     m_selectionEnd = NULL;
-    RecalculateForce();
+    ScheduleRelayout();
   }
   else
     AdjustSize();
@@ -523,6 +1122,7 @@ bool MathCtrl::IsLesserGCType(int type, int comparedTo) {
  * to a fold occurring.
  */
 void MathCtrl::FoldOccurred() {
+  InvalidateGroupIndex();
   SetSaved(false);
   UpdateMLast();
 }
@@ -610,6 +1210,7 @@ GroupCell *MathCtrl::TearOutTree(GroupCell *start, GroupCell *end) {
   MathCell *prev = start->m_previous;
   MathCell *next = end->m_next;
 
+  InvalidateGroupIndex();
   end->m_next = end->m_nextToDraw = NULL;
   start->m_previous = start->m_previousToDraw = NULL;
 
@@ -709,6 +1310,11 @@ void MathCtrl::OnMouseRightDown(wxMouseEvent& event) {
         }
         popupMenu->AppendSeparator();
         popupMenu->Append(popid_evaluate, _("Evaluate Cell(s)"), wxEmptyString, wxITEM_NORMAL);
+        if (m_selectionStart == m_selectionEnd &&
+            m_evaluationQueue->IsInQueue(dynamic_cast<GroupCell*>(m_selectionStart)) &&
+            m_evaluationQueue->GetFirst() != m_selectionStart)
+          popupMenu->Append(popid_remove_from_queue, _("Remove From Evaluation Queue"),
+                            wxEmptyString, wxITEM_NORMAL);
 
         if (m_selectionStart != m_selectionEnd)
           popupMenu->Append(popid_merge_cells, _("Merge Cells"), wxEmptyString, wxITEM_NORMAL);
@@ -807,11 +1413,13 @@ void MathCtrl::OnMouseLeftDown(wxMouseEvent& event) {
   m_hCaretActive = false;
   SetActiveCell(NULL, false);
 
-  GroupCell * tmp = m_tree;
   wxRect rect;
   GroupCell * clickedBeforeGC = NULL;
   GroupCell * clickedInGC = NULL;
-  while (tmp != NULL) { // go through all groupcells
+  // groups above the first one from the index end above m_down
+  size_t first = FindGroupBelow(m_down.y);
+  GroupCell * tmp = first < m_groupIndex.size() ? m_groupIndex[first] : NULL;
+  while (tmp != NULL) { // go through the groupcells from there
     rect = tmp->GetRect();
     if (m_down.y < rect.GetTop() )
     {
@@ -868,7 +1476,7 @@ void MathCtrl::OnMouseLeftDown(wxMouseEvent& event) {
           m_clickType = CLICK_TYPE_INPUT_SELECTION;
           if (editor->GetWidth() == -1)
             Recalculate();
-          Refresh();
+          RefreshView();
           return;
         }
       }
@@ -887,7 +1495,24 @@ void MathCtrl::OnMouseLeftDown(wxMouseEvent& event) {
             m_activeCell->SelectPointText(dc, m_down);
             m_switchDisplayCaret = false;
             m_clickType = CLICK_TYPE_INPUT_SELECTION;
-            Refresh();
+            RefreshView();
+            return;
+          }
+          else if (m_selectionStart == m_selectionEnd &&
+                   dynamic_cast<MoreCell*>(m_selectionStart) != NULL)
+          {
+            ShowMore(dynamic_cast<MoreCell*>(m_selectionStart));
+            return;
+          }
+          else if (m_selectionStart == m_selectionEnd &&
+                   dynamic_cast<SpoolCell*>(m_selectionStart) != NULL)
+          {
+            wxString file = dynamic_cast<SpoolCell*>(m_selectionStart)->GetFile();
+            m_selectionStart = m_selectionEnd = NULL;
+            m_clickType = CLICK_TYPE_NONE;
+            if (wxFileExists(file))
+              wxLaunchDefaultBrowser(wxFileSystem::FileNameToURL(wxFileName(file)));
+            RefreshView();
             return;
           }
           else {
@@ -906,7 +1531,7 @@ void MathCtrl::OnMouseLeftDown(wxMouseEvent& event) {
     SetHCaret(m_last, false);
     m_clickType = CLICK_TYPE_GROUP_SELECTION;
   }
-  Refresh();
+  RefreshView();
 }
 
 void MathCtrl::OnMouseLeftUp(wxMouseEvent& event) {
@@ -971,7 +1596,8 @@ void MathCtrl::ClickNDrag(wxPoint down, wxPoint up) {
       int ytop    = MIN( down.y, up.y );
       int ybottom = MAX( down.y, up.y );
       // find out group cells between ytop and ybottom (including these two points)
-      GroupCell * tmp = m_tree;
+      size_t first = FindGroupBelow(ytop);
+      GroupCell * tmp = first < m_groupIndex.size() ? m_groupIndex[first] : NULL;
       while (tmp != NULL) {
         rect = tmp->GetRect();
         if (ytop <= rect.GetBottom()) {
@@ -986,7 +1612,7 @@ void MathCtrl::ClickNDrag(wxPoint down, wxPoint up) {
         return;
       }
 
-      tmp = m_tree;
+      // the selection ends above the first group below ybottom
       while (tmp != NULL) {
         rect = tmp->GetRect();
         if (ybottom < rect.GetTop()) {
@@ -1024,7 +1650,7 @@ void MathCtrl::ClickNDrag(wxPoint down, wxPoint up) {
 
   // Refresh only if the selection has changed
   if (st != m_selectionStart || en != m_selectionEnd)
-    Refresh();
+    RefreshView();
 }
 
 /***
@@ -1211,6 +1837,8 @@ bool MathCtrl::CanDeleteSelection() {
  * Delete the selection
  */
 void MathCtrl::DeleteSelection(bool deletePrompt) {
+  FlushOutput();
+  m_outputScroll = NULL;
   if (m_selectionStart == NULL || m_selectionEnd == NULL ||
       m_workingGroup != NULL)
     return;
@@ -1244,6 +1872,7 @@ void MathCtrl::DeleteSelection(bool deletePrompt) {
   }
 
   GroupCell *newSelection = dynamic_cast<GroupCell*>(end->m_next);
+  InvalidateGroupIndex();
 
   if (end == m_last)
     m_last = dynamic_cast<GroupCell*>(start->m_previous);
@@ -1554,7 +2183,7 @@ void MathCtrl::OnChar(wxKeyEvent& event) {
           (m_activeCell == group->GetEditable()))
         group->ResetInputLabel();
       Recalculate();
-      Refresh();
+      RefreshView();
     }
 
     /// Otherwise refresh only the active cell
@@ -1624,11 +2253,11 @@ void MathCtrl::OnChar(wxKeyEvent& event) {
                 ShowPoint(m_activeCell->PositionToPoint(parser));
                 if (editor->GetWidth() == -1)
                   Recalculate();
-                Refresh();
+                RefreshView();
               }
               else { // can't get editor... jump over cell..
                 m_hCaretPosition = dynamic_cast<GroupCell*>( m_hCaretPosition->m_previous);
-                Refresh();
+                RefreshView();
               }
             }
             else
@@ -1643,7 +2272,7 @@ void MathCtrl::OnChar(wxKeyEvent& event) {
           else if (!ActivatePrevInput())
             event.Skip();
           else
-            Refresh();
+            RefreshView();
         }
 
         break;
@@ -1685,11 +2314,11 @@ void MathCtrl::OnChar(wxKeyEvent& event) {
                 ShowPoint(m_activeCell->PositionToPoint(parser));
                 if (editor->GetWidth() == -1)
                   Recalculate();
-                Refresh();
+                RefreshView();
               }
               else { // else jump over
                 m_hCaretPosition = m_tree;
-                Refresh();
+                RefreshView();
               }
             }
 
@@ -1703,11 +2332,11 @@ void MathCtrl::OnChar(wxKeyEvent& event) {
                 ShowPoint(m_activeCell->PositionToPoint(parser));
                 if (editor->GetWidth() == -1)
                   Recalculate();
-                Refresh();
+                RefreshView();
               }
               else { // can't get editor.. jump over cell..
                 m_hCaretPosition = dynamic_cast<GroupCell*>( m_hCaretPosition->m_next);
-                Refresh();
+                RefreshView();
               }
             }
 
@@ -1723,7 +2352,7 @@ void MathCtrl::OnChar(wxKeyEvent& event) {
           else if (!ActivateNextInput())
             event.Skip();
           else
-            Refresh();
+            RefreshView();
         }
 
         break;
@@ -1763,7 +2392,7 @@ void MathCtrl::OnChar(wxKeyEvent& event) {
             if (m_hCaretPosition != NULL) {
               SetSelection(m_hCaretPosition);
               m_hCaretActive = false;
-              Refresh();
+              RefreshView();
               return;
             }
             break;
@@ -1773,14 +2402,14 @@ void MathCtrl::OnChar(wxKeyEvent& event) {
               if (m_tree != NULL) {
                 SetSelection(m_tree);
                 m_hCaretActive = false;
-                Refresh();
+                RefreshView();
                 return;
               }
             }
             else if (m_hCaretPosition->m_next != NULL) {
               SetSelection(m_hCaretPosition->m_next);
               m_hCaretActive = false;
-              Refresh();
+              RefreshView();
               return;
             }
             break;
@@ -1824,7 +2453,7 @@ void MathCtrl::OnChar(wxKeyEvent& event) {
         m_selectionEnd = m_hCaretPositionStart;
       }
 
-      Refresh();
+      RefreshView();
     }
   }
 }
@@ -1833,20 +2462,10 @@ void MathCtrl::OnChar(wxKeyEvent& event) {
  * Get maximum x and y in the tree.
  */
 void MathCtrl::GetMaxPoint(int* width, int* height) {
-  MathCell* tmp = m_tree;
-  int currentHeight= MC_BASE_INDENT;
-  int currentWidth= MC_BASE_INDENT;
-  *width = MC_BASE_INDENT;
-  *height = MC_BASE_INDENT;
-
-  while (tmp != NULL) {
-    currentHeight += tmp->GetMaxHeight();
-    currentHeight += MC_GROUP_SKIP;
-    *height = currentHeight;
-    currentWidth = MC_BASE_INDENT + tmp->GetWidth();
-    *width = MAX(currentWidth + MC_BASE_INDENT, *width);
-    tmp = tmp->m_next;
-  }
+  if (!m_groupIndexValid)
+    UpdateGroupIndex();
+  *width = m_groupIndexWidth;
+  *height = m_groupIndexHeight;
 }
 
 /***
@@ -1926,6 +2545,28 @@ void MathCtrl::OnTimer(wxTimerEvent& event) {
           m_animate = false;
       }
       break;
+    case OUTPUT_TIMER_ID:
+      if (m_outputGroup != NULL)
+        FlushOutput();
+      else if (m_outputScroll != NULL)
+      {
+        ScrollToCell(m_outputScroll);
+        m_outputScroll = NULL;
+      }
+      break;
+    case FLASH_TIMER_ID:
+      {
+        m_unflash.Union(m_flashed);
+        wxRegionIterator it(m_flashed);
+        while (it) {
+          wxRect rect = it.GetRect();
+          CalcScrolledPosition(rect.x, rect.y, &rect.x, &rect.y);
+          wxScrolledCanvas::Refresh(true, &rect);
+          it++;
+        }
+        m_flashed.Clear();
+      }
+      break;
     case CARET_TIMER_ID:
       {
         if (m_activeCell != NULL) {
@@ -1948,10 +2589,13 @@ void MathCtrl::OnTimer(wxTimerEvent& event) {
  * Destroy the tree
  */
 void MathCtrl::DestroyTree() {
+  m_outputGroup = m_outputScroll = NULL;
+  m_outputTimer.Stop();
   m_hCaretActive = false;
   m_hCaretPosition = NULL;
   DestroyTree(m_tree);
   m_tree = m_last = NULL;
+  InvalidateGroupIndex();
 }
 
 void MathCtrl::DestroyTree(MathCell* tmp) {
@@ -2884,12 +3528,12 @@ bool MathCtrl::CanEdit() {
 void MathCtrl::OnDoubleClick(wxMouseEvent &event) {
   if (m_activeCell != NULL) {
     m_activeCell->SelectWordUnderCaret();
-    Refresh();
+    RefreshView();
   }
   else if (m_selectionStart != NULL) {
     GroupCell *parent = dynamic_cast<GroupCell*>(m_selectionStart->GetParent());
     parent->SelectOutput(&m_selectionStart, &m_selectionEnd);
-    Refresh();
+    RefreshView();
   }
 }
 
@@ -2927,7 +3571,7 @@ bool MathCtrl::ActivatePrevInput() {
   SetActiveCell(inpt, false);
   m_activeCell->CaretToEnd();
 
-  Refresh();
+  RefreshView();
 
   return true;
 }
@@ -2969,7 +3613,7 @@ bool MathCtrl::ActivateNextInput(bool input) {
   SetActiveCell(inpt, false);
   m_activeCell->CaretToStart();
 
-  Refresh();
+  RefreshView();
 
   return true;
 }
@@ -3059,7 +3703,7 @@ void MathCtrl::ScrollToCell(MathCell *cell)
   else if (cellY - cellCenter - SCROLL_UNIT < view_y && cellDrop + cellCenter < height)
     Scroll(-1, MAX(cellY/SCROLL_UNIT - 2, 0));
 
-  Refresh();
+  RefreshView();
 }
 
 void MathCtrl::SetActiveCell(EditorCell *cell, bool callRefresh) {
@@ -3088,7 +3732,7 @@ void MathCtrl::SetActiveCell(EditorCell *cell, bool callRefresh) {
     m_hCaretActive = false; // we have activeted a cell .. disable caret
 
   if (callRefresh) // = true default
-    Refresh();
+    RefreshView();
 }
 
 void MathCtrl::ShowPoint(wxPoint point) {
@@ -3313,7 +3957,7 @@ void MathCtrl::SelectAll()
   else if (m_activeCell != NULL)
     m_activeCell->SelectAll();
 
-  Refresh();
+  RefreshView();
 }
 
 void MathCtrl::DivideCell()
@@ -3430,6 +4074,7 @@ void MathCtrl::Animate(bool run) {
 }
 
 void MathCtrl::SetWorkingGroup(GroupCell *group) {
+  FlushOutput();
   if (m_workingGroup != NULL)
     m_workingGroup->SetWorking(false);
   m_workingGroup = group;
@@ -3484,7 +4129,7 @@ void MathCtrl::SetHCaret(MathCell *where, bool callRefresh)
   m_hCaretActive = true;
 
   if (callRefresh) // = true default
-    Refresh();
+    RefreshView();
 }
 
 void MathCtrl::ShowHCaret()
@@ -3893,10 +4538,92 @@ void MathCtrl::OpenNextOrCreateCell()
     OpenHCaret();
 }
 
+/***
+ * Counts the cells of the document (with the folded groups) by class. The
+ * bytes are the sizes of the objects and of their text, not of images.
+ */
+wxString MathCtrl::GetMemoryReport()
+{
+  static const struct {
+    const std::type_info *type;
+    const wxChar *name;
+    size_t size;
+  } types[] = {
+    { &typeid(GroupCell), wxT("GroupCell"), sizeof(GroupCell) },
+    { &typeid(EditorCell), wxT("EditorCell"), sizeof(EditorCell) },
+    { &typeid(TextCell), wxT("TextCell"), sizeof(TextCell) },
+    { &typeid(MoreCell), wxT("MoreCell"), sizeof(MoreCell) },
+    { &typeid(SpoolCell), wxT("SpoolCell"), sizeof(SpoolCell) },
+    { &typeid(FracCell), wxT("FracCell"), sizeof(FracCell) },
+    { &typeid(ExptCell), wxT("ExptCell"), sizeof(ExptCell) },
+    { &typeid(SubCell), wxT("SubCell"), sizeof(SubCell) },
+    { &typeid(SubSupCell), wxT("SubSupCell"), sizeof(SubSupCell) },
+    { &typeid(ParenCell), wxT("ParenCell"), sizeof(ParenCell) },
+    { &typeid(FunCell), wxT("FunCell"), sizeof(FunCell) },
+    { &typeid(SqrtCell), wxT("SqrtCell"), sizeof(SqrtCell) },
+    { &typeid(AbsCell), wxT("AbsCell"), sizeof(AbsCell) },
+    { &typeid(AtCell), wxT("AtCell"), sizeof(AtCell) },
+    { &typeid(DiffCell), wxT("DiffCell"), sizeof(DiffCell) },
+    { &typeid(IntCell), wxT("IntCell"), sizeof(IntCell) },
+    { &typeid(LimitCell), wxT("LimitCell"), sizeof(LimitCell) },
+    { &typeid(SumCell), wxT("SumCell"), sizeof(SumCell) },
+    { &typeid(MatrCell), wxT("MatrCell"), sizeof(MatrCell) },
+    { &typeid(ImgCell), wxT("ImgCell"), sizeof(ImgCell) },
+    { &typeid(SlideShow), wxT("SlideShow"), sizeof(SlideShow) },
+    { &typeid(SharedCell), wxT("SharedCell"), sizeof(SharedCell) },
+  };
+  const size_t count = sizeof(types) / sizeof(types[0]);
+  std::vector<long> cells(count + 1, 0);
+  std::vector<long> bytes(count + 1, 0);
+
+  // The lists which are not counted yet, shared subtrees are counted once
+  std::vector<MathCell*> lists;
+  std::set<MathCell*> counted;
+  lists.push_back(m_tree);
+  while (!lists.empty())
+  {
+    MathCell *tmp = lists.back();
+    lists.pop_back();
+    if (!counted.insert(tmp).second)
+      continue;
+    for (; tmp != NULL; tmp = tmp->m_next)
+    {
+      size_t i = 0;
+      while (i < count && *types[i].type != typeid(*tmp))
+        i++;
+      cells[i]++;
+      bytes[i] += (i < count ? types[i].size : sizeof(MathCell)) +
+                  tmp->GetValue().Length() * sizeof(wxChar);
+      tmp->GetInnerCells(lists);
+    }
+  }
+
+  wxString report;
+  long totalCells = 0, totalBytes = 0;
+  for (size_t i = 0; i <= count; i++)
+  {
+    if (cells[i] == 0)
+      continue;
+    report << wxString::Format(wxT("%s: %ld cells, %ld kB, %ld bytes/cell\n"),
+                               i < count ? types[i].name : wxT("Other"),
+                               cells[i], bytes[i] / 1024, bytes[i] / cells[i]);
+    totalCells += cells[i];
+    totalBytes += bytes[i];
+  }
+  report << wxString::Format(_("Total: %ld cells, %ld kB\n"
+                               "Cell pool: %ld cells, %ld kB\n"
+                               "Interned strings: %ld"),
+                             totalCells, totalBytes / 1024,
+                             CellPool::GetCells(), CellPool::GetBytes() / 1024,
+                             StringPool::GetCount());
+  return report;
+}
+
 BEGIN_EVENT_TABLE(MathCtrl, wxScrolledCanvas)
   EVT_MENU_RANGE(popid_complete_00, popid_complete_00 + AC_MENU_LENGTH, MathCtrl::OnComplete)
   EVT_SIZE(MathCtrl::OnSize)
   EVT_PAINT(MathCtrl::OnPaint)
+  EVT_IDLE(MathCtrl::OnIdle)
   EVT_LEFT_UP(MathCtrl::OnMouseLeftUp)
   EVT_LEFT_DOWN(MathCtrl::OnMouseLeftDown)
   EVT_RIGHT_DOWN(MathCtrl::OnMouseRightDown)
@@ -3907,6 +4634,8 @@ BEGIN_EVENT_TABLE(MathCtrl, wxScrolledCanvas)
   EVT_TIMER(TIMER_ID, MathCtrl::OnTimer)
   EVT_TIMER(CARET_TIMER_ID, MathCtrl::OnTimer)
   EVT_TIMER(ANIMATION_TIMER_ID, MathCtrl::OnTimer)
+  EVT_TIMER(OUTPUT_TIMER_ID, MathCtrl::OnTimer)
+  EVT_TIMER(FLASH_TIMER_ID, MathCtrl::OnTimer)
   EVT_KEY_DOWN(MathCtrl::OnKeyDown)
   EVT_CHAR(MathCtrl::OnChar)
   EVT_ERASE_BACKGROUND(MathCtrl::OnEraseBackground)
@@ -24,11 +24,17 @@
 #include <wx/wx.h>
 #include <wx/textfile.h>
 
+#include <vector>
+
 #include "MathCell.h"
 #include "EditorCell.h"
 #include "GroupCell.h"
 #include "EvaluationQueue.h"
 #include "Autocomplete.h"
+#include "MoreCell.h"
+#include "SpoolCell.h"
+#include "TileCache.h"
+#include "OutputCache.h"
 
 #if !wxCHECK_VERSION(2,9,0)
   typedef wxScrolledWindow wxScrolledCanvas;
@@ -63,6 +69,7 @@ enum {
   popid_animation_start,
   popid_evaluate,
   popid_merge_cells,
+  popid_remove_from_queue,
   popid_insert_text,
   popid_insert_title,
   popid_insert_section,
@@ -88,6 +95,19 @@ public:
   MathCell* CopyTree();
   GroupCell *InsertGroupCells(GroupCell* tree, GroupCell* where = NULL);
   void InsertLine(MathCell *newLine, bool forceNewLine = false);
+  void FlushOutput(bool scroll = true);
+  void ShowMore(MoreCell *more);
+  void ResetOutputStats() { m_outputLines = m_outputFlushes = m_groupsMeasured = 0; }
+  long GetOutputLines() { return m_outputLines; }
+  long GetOutputFlushes() { return m_outputFlushes; }
+  long GetGroupsMeasured() { return m_groupsMeasured; }
+  long GetTilesRendered() { return m_tiles.GetRendered(); }
+  long GetTilesReused() { return m_tiles.GetReused(); }
+  wxString GetMemoryReport();
+  void Refresh(bool eraseBackground = true, const wxRect *rect = NULL);
+  void RefreshView();
+  void SetFlashRepaints(bool flash) { m_flashRepaints = flash; Refresh(); }
+  bool GetFlashRepaints() { return m_flashRepaints; }
   void Recalculate(bool force = false);
   void RecalculateForce();
   void ClearDocument(); // used when opening new file in wxMaxima.cpp
@@ -197,7 +217,10 @@ public:
   // methods for zooming the document in and out
   double GetZoomFactor() { return m_zoomFactor; }
   void SetZoomFactor(double newzoom, bool recalc = true) { m_zoomFactor = newzoom;
-    if (recalc) {RecalculateForce(); Refresh();} }
+    FontCache::Clear();
+    OutputCache::Clear();
+    if (recalc) {ScheduleRelayout(); Refresh();} }
+  void ScheduleRelayout();
   void CommentSelection();
   void OnMouseWheel(wxMouseEvent &ev);
   bool FindNext(wxString str, bool down, bool ignoreCase);
@@ -216,10 +239,32 @@ protected:
   MathCell* CopySelection();
   MathCell* CopySelection(MathCell* start, MathCell* end, bool asData = false);
   void GetMaxPoint(int* width, int* height);
+  void UpdateGroupIndex(size_t from = 0);
+  bool RecalculateVisible();
+  void OnIdle(wxIdleEvent& event);
+  void InvalidateGroupIndex() { m_groupIndexValid = false; }
+  size_t FindGroupBelow(int y);
   void OnTimer(wxTimerEvent& event);
   void OnMouseExit(wxMouseEvent& event);
   void OnMouseEnter(wxMouseEvent& event);
   void OnPaint(wxPaintEvent& event);
+  void DrawTile(wxBitmap& bitmap, int x, int y);
+  /***
+   * Something drawn over or around the cells: the selection, the carets,
+   * the active cell and the evaluation queue. RefreshView compares them
+   * with the ones which are drawn in m_tiles.
+   */
+  struct Decoration
+  {
+    int kind;
+    wxRect rect;
+    bool operator<(const Decoration& other) const;
+  };
+  void GetDecorations(std::vector<Decoration>& decorations);
+  void AddDecoration(std::vector<Decoration>& decorations, int kind, wxRect rect);
+  void Damage(const wxRect& rect);
+  void DamageBelow(int y);
+  void FlushDamage();
   void OnSize(wxSizeEvent& event);
   void OnMouseRightDown(wxMouseEvent& event);
   void OnMouseLeftUp(wxMouseEvent& event);
@@ -257,9 +302,29 @@ protected:
   CellParser *m_selectionParser;
   bool m_switchDisplayCaret;
   bool m_editingEnabled;
-  wxTimer m_timer, m_caretTimer, m_animationTimer;
+  wxTimer m_timer, m_caretTimer, m_animationTimer, m_outputTimer, m_flashTimer;
+  GroupCell *m_outputGroup;    // group with output which is not laid out yet
+  GroupCell *m_outputScroll;   // group with new output which is not scrolled to
+  long m_outputLines;          // lines inserted since ResetOutputStats
+  long m_outputFlushes;        // layout passes for these lines
+  long m_groupsMeasured;       // groups recalculated since ResetOutputStats
+  std::vector<GroupCell*> m_groupIndex; // the groups of m_tree in order
+  std::vector<int> m_groupTop;          // top of each group in m_groupIndex
+  std::vector<int> m_groupBottom;       // bottom of each group in m_groupIndex
+  std::vector<int> m_groupCenter;       // center and drop of each group when
+  std::vector<int> m_groupDrop;         // it was positioned
+  int m_groupIndexWidth, m_groupIndexHeight; // size of the document
+  bool m_groupIndexValid;
+  bool m_relayoutPending;      // some groups are stale
+  size_t m_relayoutNext;       // where OnIdle looks for stale groups
   bool m_animate;
-  wxBitmap *m_memory;
+  TileCache m_tiles;           // rendered parts of the document
+  std::vector<Decoration> m_decorations; // decorations drawn in m_tiles
+  bool m_decorationsValid;     // false after a Refresh of the whole window
+  wxRegion m_damage;           // to be repainted at the next FlushDamage
+  bool m_flashRepaints;        // debug: show which parts are repainted
+  wxRegion m_flashed;          // flashed parts, cleared by m_flashTimer
+  wxRegion m_unflash;          // parts repainted to clear the flash
   bool m_saved;
   double m_zoomFactor;
   AutoComplete m_autocomplete;
@@ -23,6 +23,8 @@
 #include <wx/sstream.h>
 #include <wx/regex.h>
 
+#include <algorithm>
+
 #include "MathParser.h"
 
 #include "FracCell.h"
@@ -44,14 +46,16 @@
 #include "SubSupCell.h"
 #include "SlideShowCell.h"
 #include "GroupCell.h"
-
-#define MAXLENGTH 50000
+#include "MoreCell.h"
 
 MathParser::MathParser(wxString zipfile)
 {
   m_ParserStyle = MC_TYPE_DEFAULT;
   m_FracStyle = FC_NORMAL;
   m_highlight = false;
+  m_warnings = true;
+  m_shareSubtrees = false;
+  m_sharedNode = NULL;
   if (zipfile.Length() > 0) {
     m_fileSystem = new wxFileSystem();
     m_fileSystem->ChangePathTo(wxT("file:") + zipfile + wxT("#zip:/"), true);
@@ -62,6 +66,7 @@ MathParser::MathParser(wxString zipfile)
 
 MathParser::~MathParser()
 {
+  ReleaseShared();
   if (m_fileSystem)
     delete m_fileSystem;
 }
@@ -634,186 +639,224 @@ MathCell* MathParser::ParseTableTag(wxXmlNode* node)
   return matrix;
 }
 
+/***
+ * The key of a subtree which can be shared: its XML and the state of the
+ * parser which changes how it is parsed. Returns false for tags which
+ * don't make a single cell and for subtrees longer than MAXSHARED, since
+ * a SharedCell is never broken into lines.
+ */
+bool MathParser::SharedKey(wxXmlNode* node, wxString& key)
+{
+  static const wxChar *tags[] = {
+    wxT("q"), wxT("e"), wxT("i"), wxT("f"), wxT("p"), wxT("fn"), wxT("a"),
+    wxT("ie"), wxT("sm"), wxT("in"), wxT("d"), wxT("lm"), wxT("at"), wxT("tb")
+  };
+
+  if (node == m_sharedNode || node->GetType() != wxXML_ELEMENT_NODE)
+    return false;
+
+  size_t i = 0, count = sizeof(tags) / sizeof(tags[0]);
+  while (i < count && node->GetName() != tags[i])
+    i++;
+  if (i == count)
+    return false;
+
+  key.Empty();
+  key << (m_highlight ? wxT("h") : wxT("n")) << m_FracStyle;
+
+  // Texts are written with their length, so no text can look like a tag
+  std::vector<wxXmlNode*> nodes;
+  nodes.push_back(node);
+  while (!nodes.empty())
+  {
+    wxXmlNode *tmp = nodes.back();
+    nodes.pop_back();
+
+    if (tmp == NULL)
+      key << wxT("</>");
+    else if (tmp->GetType() != wxXML_ELEMENT_NODE)
+      key << (int)tmp->GetContent().Length() << wxT(":") << tmp->GetContent();
+    else
+    {
+      key << wxT("<") << tmp->GetName();
+#if wxCHECK_VERSION(2,9,0)
+      for (wxXmlAttribute *attr = tmp->GetAttributes(); attr != NULL;
+           attr = attr->GetNext())
+#else
+      for (wxXmlProperty *attr = tmp->GetProperties(); attr != NULL;
+           attr = attr->GetNext())
+#endif
+        key << wxT(" ") << attr->GetName() << wxT("=")
+            << (int)attr->GetValue().Length() << wxT(":") << attr->GetValue();
+      key << wxT(">");
+
+      // Children are pushed in reverse, after the end of the tag
+      nodes.push_back(NULL);
+      size_t first = nodes.size();
+      for (wxXmlNode *child = tmp->GetChildren(); child != NULL;
+           child = child->GetNext())
+        nodes.push_back(child);
+      std::reverse(nodes.begin() + first, nodes.end());
+    }
+
+    if (key.Length() > MAXSHARED)
+      return false;
+  }
+  return true;
+}
+
+/***
+ * Returns a SharedCell for node. The first occurrence of key is parsed
+ * and its cell becomes the tree of the later ones.
+ */
+MathCell* MathParser::ParseShared(wxXmlNode* node, const wxString& key)
+{
+  SharedTrees::iterator it = m_sharedTrees.find(key);
+  if (it != m_sharedTrees.end())
+    return new SharedCell(it->second);
+
+  wxXmlNode *sharedNode = m_sharedNode;
+  m_sharedNode = node;
+  MathCell *cell = ParseTag(node, false);
+  m_sharedNode = sharedNode;
+
+  if (cell == NULL || cell->m_next != NULL)
+    return cell;
+
+  SharedCell *shared = new SharedCell(cell);
+  SharedCell::Retain(shared->GetTree());
+  m_sharedTrees[key] = shared->GetTree();
+  return shared;
+}
+
+/***
+ * Subtrees are only shared inside one output. The trees stay alive as
+ * long as some SharedCell uses them.
+ */
+void MathParser::ReleaseShared()
+{
+  for (SharedTrees::iterator it = m_sharedTrees.begin();
+       it != m_sharedTrees.end(); ++it)
+    SharedCell::Release(it->second);
+  m_sharedTrees.clear();
+}
+
 MathCell* MathParser::ParseTag(wxXmlNode* node, bool all)
 {
   //  wxYield();
-  MathCell* tmp = NULL;
-  MathCell* cell = NULL;
-  bool warning = all;
+  CellList cells;
+  bool warning = all && m_warnings;
   wxString altCopy;
 
   while (node)
   {
+    MathCell *piece = NULL;
+    wxString key;
+
+    // Repeated subtrees
+    if (m_shareSubtrees && SharedKey(node, key))
+      piece = ParseShared(node, key);
     // Parse tags
-    if (node->GetType() == wxXML_ELEMENT_NODE)
+    else if (node->GetType() == wxXML_ELEMENT_NODE)
     {
       wxString tagName(node->GetName());
 
       if (tagName == wxT("v"))
       {               // Variables (atoms)
-        if (cell == NULL)
-          cell = ParseText(node->GetChildren(), TS_VARIABLE);
-        else
-          cell->AppendCell(ParseText(node->GetChildren(), TS_VARIABLE));
+        piece = ParseText(node->GetChildren(), TS_VARIABLE);
       }
       else if (tagName == wxT("t"))
       {          // Other text
-        if (cell == NULL)
-          cell = ParseText(node->GetChildren(), TS_DEFAULT);
-        else
-          cell->AppendCell(ParseText(node->GetChildren(), TS_DEFAULT));
+        piece = ParseText(node->GetChildren(), TS_DEFAULT);
       }
       else if (tagName == wxT("n"))
       {          // Numbers
-        if (cell == NULL)
-          cell = ParseText(node->GetChildren(), TS_NUMBER);
-        else
-          cell->AppendCell(ParseText(node->GetChildren(), TS_NUMBER));
+        piece = ParseText(node->GetChildren(), TS_NUMBER);
       }
       else if (tagName == wxT("h"))
       {          // Hidden cells (*)
         MathCell* tmp = ParseText(node->GetChildren());
         tmp->m_isHidden = true;
-        if (cell == NULL)
-          cell = tmp;
-        else
-          cell->AppendCell(tmp);
+        piece = tmp;
       }
       else if (tagName == wxT("p"))
       {          // Parenthesis
-        if (cell == NULL)
-          cell = ParseParenTag(node);
-        else
-          cell->AppendCell(ParseParenTag(node));
+        piece = ParseParenTag(node);
       }
       else if (tagName == wxT("f"))
       {               // Fractions
-        if (cell == NULL)
-          cell = ParseFracTag(node);
-        else
-          cell->AppendCell(ParseFracTag(node));
+        piece = ParseFracTag(node);
       }
       else if (tagName == wxT("e"))
       {          // Exponentials
-        if (cell == NULL)
-          cell = ParseSupTag(node);
-        else
-          cell->AppendCell(ParseSupTag(node));
+        piece = ParseSupTag(node);
       }
       else if (tagName == wxT("i"))
       {          // Subscripts
-        if (cell == NULL)
-          cell = ParseSubTag(node);
-        else
-          cell->AppendCell(ParseSubTag(node));
+        piece = ParseSubTag(node);
       }
       else if (tagName == wxT("fn"))
       {         // Functions
-        if (cell == NULL)
-          cell = ParseFunTag(node);
-        else
-          cell->AppendCell(ParseFunTag(node));
+        piece = ParseFunTag(node);
       }
       else if (tagName == wxT("g"))
       {          // Greek constants
         MathCell* tmp = ParseText(node->GetChildren(), TS_GREEK_CONSTANT);
-        if (cell == NULL)
-          cell = tmp;
-        else
-          cell->AppendCell(tmp);
+        piece = tmp;
       }
       else if (tagName == wxT("s"))
       {          // Special constants %e,...
         MathCell* tmp = ParseText(node->GetChildren(), TS_SPECIAL_CONSTANT);
-        if (cell == NULL)
-          cell = tmp;
-        else
-          cell->AppendCell(tmp);
+        piece = tmp;
       }
       else if (tagName == wxT("fnm"))
       {         // Function names
         MathCell* tmp = ParseText(node->GetChildren(), TS_FUNCTION);
-        if (cell == NULL)
-          cell = tmp;
-        else
-          cell->AppendCell(tmp);
+        piece = tmp;
       }
       else if (tagName == wxT("q"))
       {          // Square roots
-        if (cell == NULL)
-          cell = ParseSqrtTag(node);
-        else
-          cell->AppendCell(ParseSqrtTag(node));
+        piece = ParseSqrtTag(node);
       }
       else if (tagName == wxT("d"))
       {          // Differentials
-        if (cell == NULL)
-          cell = ParseDiffTag(node);
-        else
-          cell->AppendCell(ParseDiffTag(node));
+        piece = ParseDiffTag(node);
       }
       else if (tagName == wxT("sm"))
       {         // Sums
-        if (cell == NULL)
-          cell = ParseSumTag(node);
-        else
-          cell->AppendCell(ParseSumTag(node));
+        piece = ParseSumTag(node);
       }
       else if (tagName == wxT("in"))
       {         // integrals
-        if (cell == NULL)
-          cell = ParseIntTag(node);
-        else
-          cell->AppendCell(ParseIntTag(node));
+        piece = ParseIntTag(node);
       }
       else if (tagName == wxT("mspace"))
       {
-        if (cell == NULL)
-          cell = new TextCell(wxT(" "));
-        else
-          cell->AppendCell(new TextCell(wxT(" ")));
+        piece = new TextCell(wxT(" "));
       }
       else if (tagName == wxT("at"))
       {
-        if (cell == NULL)
-          cell = ParseAtTag(node);
-        else
-          cell->AppendCell(ParseAtTag(node));
+        piece = ParseAtTag(node);
       }
       else if (tagName == wxT("a"))
       {
-        if (cell == NULL)
-          cell = ParseAbsTag(node);
-        else
-          cell->AppendCell(ParseAbsTag(node));
+        piece = ParseAbsTag(node);
       }
       else if (tagName == wxT("ie"))
       {
-        if (cell == NULL)
-          cell = ParseSubSupTag(node);
-        else
-          cell->AppendCell(ParseSubSupTag(node));
+        piece = ParseSubSupTag(node);
       }
       else if (tagName == wxT("lm"))
       {
-        if (cell == NULL)
-          cell = ParseLimitTag(node);
-        else
-          cell->AppendCell(ParseLimitTag(node));
+        piece = ParseLimitTag(node);
       }
       else if (tagName == wxT("r"))
       {
-        if (cell == NULL)
-          cell = ParseTag(node->GetChildren());
-        else
-          cell->AppendCell(ParseTag(node->GetChildren()));
+        piece = ParseTag(node->GetChildren());
       }
       else if (tagName == wxT("tb"))
       {
-        if (cell == NULL)
-          cell = ParseTableTag(node);
-        else
-          cell->AppendCell(ParseTableTag(node));
+        piece = ParseTableTag(node);
       }
       else if ((tagName == wxT("mth")) || (tagName == wxT("line")))
       {
@@ -822,27 +865,18 @@ MathCell* MathParser::ParseTag(wxXmlNode* node, bool all)
           tmp->ForceBreakLine(true);
         else
           tmp = new TextCell(wxT(" "));
-        if (cell == NULL)
-          cell = tmp;
-        else
-          cell->AppendCell(tmp);
+        piece = tmp;
       }
       else if (tagName == wxT("lbl"))
       {
         MathCell* tmp = ParseText(node->GetChildren(), TS_LABEL);
         tmp->ForceBreakLine(true);
-        if (cell == NULL)
-          cell = tmp;
-        else
-          cell->AppendCell(tmp);
+        piece = tmp;
       }
       else if (tagName == wxT("st"))
       {
         MathCell* tmp = ParseText(node->GetChildren(), TS_STRING);
-        if (cell == NULL)
-          cell = tmp;
-        else
-          cell->AppendCell(tmp);
+        piece = tmp;
       }
       else if (tagName == wxT("hl"))
       {
@@ -850,10 +884,7 @@ MathCell* MathParser::ParseTag(wxXmlNode* node, bool all)
         m_highlight = true;
         MathCell* tmp = ParseTag(node->GetChildren());
         m_highlight = highlight;
-        if (cell == NULL)
-          cell = tmp;
-        else
-          cell->AppendCell(tmp);
+        piece = tmp;
       }
       else if (tagName == wxT("img"))
       {
@@ -884,10 +915,7 @@ MathCell* MathParser::ParseTag(wxXmlNode* node, bool all)
           tmp->DrawRectangle(false);
 #endif
 
-        if (cell == NULL)
-          cell = tmp;
-        else
-          cell->AppendCell(tmp);
+        piece = tmp;
       }
       else if (tagName == wxT("slide"))
       {
@@ -907,59 +935,35 @@ MathCell* MathParser::ParseTag(wxXmlNode* node, bool all)
           }
         }
         tmp->LoadImages(images);
-        if (cell == NULL)
-          cell = tmp;
-        else
-          cell->AppendCell(tmp);
+        piece = tmp;
       }
       else if (tagName == wxT("editor"))
       {
-        if (cell == NULL)
-          cell = ParseEditorTag(node);
-        else
-          cell->AppendCell(ParseEditorTag(node));
+        piece = ParseEditorTag(node);
       }
       else if (tagName == wxT("cell"))
       {
-        if (cell == NULL)
-          cell = ParseCellTag(node);
-        else
-          cell->AppendCell(ParseCellTag(node));
+        piece = ParseCellTag(node);
       }
       else if (tagName == wxT("ascii"))
       {
-        if (cell == NULL)
-          cell = ParseCharCode(node->GetChildren());
-        else
-          cell->AppendCell(ParseCharCode(node->GetChildren()));
+        piece = ParseCharCode(node->GetChildren());
       }
       else if (node->GetChildren())
       {
-        if (cell == NULL)
-          cell = ParseTag(node->GetChildren());
-        else
-          cell->AppendCell(ParseTag(node->GetChildren()));
+        piece = ParseTag(node->GetChildren());
       }
     }
     // Parse text
     else
     {
-      if (cell == NULL)
-        cell = ParseText(node);
-      else
-        cell->AppendCell(ParseText(node));
+      piece = ParseText(node);
     }
+    cells.Append(piece);
     if (!all)
       break;
 
-    if (cell != NULL)
-    {
-      if (tmp == NULL)
-        tmp = cell;
-      else
-        cell = cell->m_next;
-    }
-    else if (warning)
+    if (cells.GetFirst() == NULL && warning)
     {
       wxMessageBox(_("Parts of the document will not be loaded correctly!"), _("Warning"),
         wxOK | wxICON_WARNING);
@@ -967,19 +971,17 @@ MathCell* MathParser::ParseTag(wxXmlNode* node, bool all)
     }
 
 #if wxCHECK_VERSION(2,9,0)
-    if (node->GetAttribute(wxT("altCopy"), &altCopy))
-      cell->SetAltCopyText(altCopy);
+    if (piece != NULL && node->GetAttribute(wxT("altCopy"), &altCopy))
+      piece->SetAltCopyText(altCopy);
 #else
-    if (node->GetPropVal(wxT("altCopy"), &altCopy))
-      cell->SetAltCopyText(altCopy);
+    if (piece != NULL && node->GetPropVal(wxT("altCopy"), &altCopy))
+      piece->SetAltCopyText(altCopy);
 #endif
 
     node = node->GetNext();
   }
 
-  if (tmp != NULL)
-    return tmp;
-  return cell;
+  return cells.GetFirst();
 }
 
 /***
@@ -987,16 +989,78 @@ MathCell* MathParser::ParseTag(wxXmlNode* node, bool all)
  * Put the result in line.
  */
 MathCell* MathParser::ParseLine(wxString s, int style)
+{
+  wxConfigBase* config = wxConfig::Get();
+  bool showLong = false, lazyLong = false;
+  config->Read(wxT("showLong"), &showLong);
+  config->Read(wxT("lazyLong"), &lazyLong);
+  m_shareSubtrees = false;
+  config->Read(wxT("shareSubtrees"), &m_shareSubtrees);
+
+  return ParseLine(s, style, showLong, lazyLong);
+}
+
+/***
+ * Parses a long output in parts. The text around the <mth> blocks and the
+ * short blocks are parsed at once. Of a long block only the first chunk of
+ * its children is parsed, the rest is kept in a MoreCell.
+ */
+MathCell* MathParser::ParseLazy(wxString s, int style)
+{
+  if (s.StartsWith(wxT("<span>")) && s.EndsWith(wxT("</span>")))
+    s = s.Mid(6, s.Length() - 13);
+
+  CellList cells;
+  size_t pos = 0;
+
+  while (pos < s.Length())
+  {
+    size_t start = s.find(wxT("<mth>"), pos);
+    size_t end = wxString::npos;
+    if (start != wxString::npos)
+      end = s.find(wxT("</mth>"), start);
+    if (end == wxString::npos)
+      start = end = s.Length();
+
+    // The text before the block
+    wxString text = s.Mid(pos, start - pos);
+    if (!wxString(text).Trim().Trim(false).IsEmpty())
+      cells.Append(MoreCell::Parse(text, style));
+
+    if (start == s.Length())
+      break;
+
+    // The block
+    size_t inner = start + 5;
+    if (end - inner < MAXLENGTH)
+      cells.Append(MoreCell::Parse(s.Mid(start, end + 6 - start), style));
+    else
+    {
+      size_t first = MoreCell::ChunkEnd(s, inner, end);
+      cells.Append(MoreCell::Parse(wxT("<mth>") + s.Mid(inner, first - inner) +
+                                   wxT("</mth>"), style));
+      if (first < end)
+        cells.Append(new MoreCell(s.Mid(first, end - first), style));
+    }
+
+    pos = end + 6;
+  }
+
+  return cells.GetFirst();
+}
+
+/***
+ * Same as above, but doesn't read the configuration, so it can be called
+ * from a worker thread. Long outputs are shown in full with showLong, in
+ * parts with lazyLong (see MoreCell) and not at all otherwise.
+ */
+MathCell* MathParser::ParseLine(wxString s, int style, bool showLong, bool lazyLong)
 {
   m_ParserStyle = style;
   m_FracStyle = FC_NORMAL;
   m_highlight = false;
   MathCell* cell = NULL;
 
-  wxConfigBase* config = wxConfig::Get();
-  bool showLong = false;
-  config->Read(wxT("showLong"), &showLong);
-
   wxRegEx graph(wxT("[[:cntrl:]]"));
 
 #if wxUSE_UNICODE
@@ -1024,10 +1088,13 @@ MathCell* MathParser::ParseLine(wxString s, int style)
     if (doc != NULL)
       cell = ParseTag(doc->GetChildren());
   }
+  else if (lazyLong && s.Find(wxT("<mth>")) != wxNOT_FOUND)
+    cell = ParseLazy(s, style);
   else
   {
     cell = new TextCell(_(" << Expression too long to display! >>"));
     cell->ForceBreakLine(true);
   }
+  ReleaseShared();
   return cell;
 }
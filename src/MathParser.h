@@ -24,9 +24,16 @@
 
 #include <wx/filesys.h>
 #include <wx/fs_arc.h>
+#include <wx/hashmap.h>
 
 #include "MathCell.h"
 #include "TextCell.h"
+#include "SharedCell.h"
+
+#define MAXLENGTH 50000  // longer outputs are not displayed at once
+#define MAXSHARED 1000   // longer subtrees are not shared
+
+WX_DECLARE_STRING_HASH_MAP(SharedTree*, SharedTrees);
 
 class MathParser
 {
@@ -34,6 +41,10 @@ public:
   MathParser(wxString zipfile = wxEmptyString);
   ~MathParser();
   MathCell* ParseLine(wxString s, int style = MC_TYPE_DEFAULT);
+  MathCell* ParseLine(wxString s, int style, bool showLong, bool lazyLong = false);
+  void SetWarnings(bool warnings) { m_warnings = warnings; }
+  // Repeated subtrees of an output are parsed once (see SharedCell)
+  void SetShareSubtrees(bool share) { m_shareSubtrees = share; }
   MathCell* ParseTag(wxXmlNode* node, bool all = true);
 private:
   MathCell* ParseCellTag(wxXmlNode* node);
@@ -55,9 +66,17 @@ private:
   MathCell* ParseLimitTag(wxXmlNode* node);
   MathCell* ParseParenTag(wxXmlNode* node);
   MathCell* ParseSubSupTag(wxXmlNode* node);
+  MathCell* ParseLazy(wxString s, int style);
+  MathCell* ParseShared(wxXmlNode* node, const wxString& key);
+  bool SharedKey(wxXmlNode* node, wxString& key);
+  void ReleaseShared();
   int m_ParserStyle;
   int m_FracStyle;
   bool m_highlight;
+  bool m_warnings;            // false if the parser must not open message boxes
+  bool m_shareSubtrees;
+  SharedTrees m_sharedTrees;  // the subtrees of the output which is parsed
+  wxXmlNode *m_sharedNode;    // the node which ParseShared parses
   wxFileSystem *m_fileSystem; // used for loading pictures in <img> and <slide>
 };
 
@@ -35,8 +35,7 @@ MatrCell::~MatrCell()
     if (m_cells[i] != NULL)
       delete m_cells[i];
   }
-  if (m_next != NULL)
-    delete m_next;
+  DeleteNext();
 }
 
 void MatrCell::SetParent(MathCell *parent, bool all)
@@ -50,6 +49,11 @@ void MatrCell::SetParent(MathCell *parent, bool all)
   MathCell::SetParent(parent, all);
 }
 
+void MatrCell::GetInnerCells(std::vector<MathCell*>& cells)
+{
+  cells.insert(cells.end(), m_cells.begin(), m_cells.end());
+}
+
 MathCell* MatrCell::Copy(bool all)
 {
   MatrCell *tmp = new MatrCell;
@@ -62,8 +66,8 @@ MathCell* MatrCell::Copy(bool all)
   tmp->m_matHeight = m_matHeight;
   for (int i = 0; i < m_matWidth*m_matHeight; i++)
     (tmp->m_cells).push_back(m_cells[i]->Copy(true));
-  if (all && m_next != NULL)
-    tmp->AppendCell(m_next->Copy(all));
+  if (all)
+    CopyNext(tmp);
   return tmp;
 }
 
@@ -56,6 +56,7 @@ public:
   void SetSpecialFlag(bool special) { m_specialMatrix = special; }
   void SetInferenceFlag(bool inference) { m_inferenceMatrix = inference; }
   void SetParent(MathCell *parent, bool all);
+  void GetInnerCells(std::vector<MathCell*>& cells);
   void RowNames(bool rn) { m_rowNames = rn; }
   void ColNames(bool cn) { m_colNames = cn; }
 protected:
@@ -0,0 +1,246 @@
+///
+///  Copyright (C) 2013 The wxMaxima team
+///
+///  This program is free software; you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation; either version 2 of the License, or
+///  (at your option) any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program; if not, write to the Free Software
+///  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+///
+
+#include "MaximaReader.h"
+
+#if WXM_READER_THREAD
+
+#if defined __GNUC__
+ #define MR_BARRIER() __sync_synchronize()
+#elif defined __WXMSW__
+ #define MR_BARRIER() MemoryBarrier()
+#else
+ #error "No memory barrier for this compiler"
+#endif
+
+wxDEFINE_EVENT(wxEVT_MAXIMA_READER, wxCommandEvent);
+
+MaximaFrameQueue::MaximaFrameQueue()
+{
+  m_head = m_tail = 0;
+}
+
+MaximaFrameQueue::~MaximaFrameQueue()
+{
+  MaximaFrame *frame;
+  while ((frame = Pop()) != NULL)
+    delete frame;
+}
+
+/***
+ * Called only by the producer. The frame is stored before the new tail is
+ * published, so the consumer never sees an unwritten slot.
+ */
+bool MaximaFrameQueue::Push(MaximaFrame *frame)
+{
+  size_t tail = m_tail;
+  if (tail - m_head == MR_QUEUE_SIZE)
+    return false;
+  m_frames[tail & (MR_QUEUE_SIZE - 1)] = frame;
+  MR_BARRIER();
+  m_tail = tail + 1;
+  return true;
+}
+
+/***
+ * Called only by the consumer.
+ */
+MaximaFrame *MaximaFrameQueue::Pop()
+{
+  size_t head = m_head;
+  if (head == m_tail)
+    return NULL;
+  MR_BARRIER();
+  MaximaFrame *frame = m_frames[head & (MR_QUEUE_SIZE - 1)];
+  MR_BARRIER();
+  m_head = head + 1;
+  return frame;
+}
+
+MaximaReader::MaximaReader(wxEvtHandler *handler, wxSocketBase *socket,
+                           MaximaStream *stream) : wxThread(wxTHREAD_JOINABLE)
+{
+  m_handler = handler;
+  m_socket = socket;
+  m_stream = stream;
+  m_readSize = SOCKET_SIZE;
+  m_stop = false;
+  m_eventPending = false;
+}
+
+MaximaReader::~MaximaReader()
+{
+}
+
+/***
+ * Takes over the socket and starts the thread. If the thread can't be
+ * started, the socket is left alone.
+ */
+bool MaximaReader::Start()
+{
+  if (Create() != wxTHREAD_NO_ERROR)
+    return false;
+
+  // The socket is used only by this thread from now on
+  m_socket->Notify(false);
+  m_socket->SetFlags(wxSOCKET_BLOCK);
+
+  return Run() == wxTHREAD_NO_ERROR;
+}
+
+/***
+ * Queues bytes which are written to maxima by the reader thread.
+ */
+void MaximaReader::Write(const char *data, size_t length)
+{
+  wxCriticalSectionLocker lock(m_writeLock);
+  m_writeData.append(data, length);
+}
+
+/***
+ * Called by the reader thread, writes the bytes queued by Write.
+ */
+void MaximaReader::WritePending()
+{
+  std::string data;
+  {
+    wxCriticalSectionLocker lock(m_writeLock);
+    data.swap(m_writeData);
+  }
+  if (!data.empty())
+    m_socket->Write(data.data(), data.length());
+}
+
+MaximaFrame *MaximaReader::GetFrame()
+{
+  return m_frames.Pop();
+}
+
+/***
+ * Called by the GUI thread before it fetches the frames, a frame pushed
+ * after this will post a new event.
+ */
+void MaximaReader::FramesRead()
+{
+  m_eventPending = false;
+  MR_BARRIER();
+}
+
+/***
+ * Stops the thread and waits for it. The frames which were already read
+ * can still be fetched with GetFrame.
+ */
+void MaximaReader::Stop()
+{
+  m_stop = true;
+  Wait();
+}
+
+/***
+ * Waits while the GUI thread is behind. The commands queued meanwhile are
+ * still written, so maxima doesn't wait for the frames to be fetched.
+ */
+void MaximaReader::PushFrame(MaximaFrame *frame)
+{
+  while (!m_frames.Push(frame))
+  {
+    if (m_stop)
+    {
+      delete frame;
+      return;
+    }
+    WritePending();
+    wxMilliSleep(1);
+  }
+
+  // Wake up the GUI thread, one event is enough until it fetched the frames
+  MR_BARRIER();
+  if (!m_eventPending)
+  {
+    m_eventPending = true;
+    wxQueueEvent(m_handler, new wxCommandEvent(wxEVT_MAXIMA_READER));
+  }
+}
+
+/***
+ * Reads everything that is available, same as wxMaxima::ReadSocket.
+ * Returns false if the connection was lost.
+ */
+bool MaximaReader::ReadSocket()
+{
+  size_t total = 0;
+
+  do
+  {
+    char *buffer = m_stream->GetWriteBuffer(m_readSize);
+    m_socket->Read(buffer, m_readSize);
+    if (m_socket->Error())
+      return total > 0;
+
+    size_t read = m_socket->LastCount();
+    if (read == 0)
+      return total > 0;
+
+    m_stream->Commit(read);
+    total += read;
+
+    if (read == m_readSize && m_readSize < SOCKET_SIZE_MAX)
+      m_readSize *= 2;
+  } while (m_socket->IsData());
+
+  if (total < m_readSize / 4 && m_readSize > SOCKET_SIZE)
+    m_readSize /= 2;
+
+  return true;
+}
+
+wxThread::ExitCode MaximaReader::Entry()
+{
+  while (!m_stop)
+  {
+    WritePending();
+
+    if (!m_socket->WaitForRead(0, MR_POLL_TIME))
+    {
+      if (m_socket->IsConnected())
+        continue;
+    }
+    else if (ReadSocket())
+    {
+      MaximaFrame *frame = new MaximaFrame;
+      while (m_stream->NextFrame(&frame->type, &frame->data))
+      {
+        PushFrame(frame);
+        frame = new MaximaFrame;
+      }
+      delete frame;
+      m_stream->Shrink();
+      continue;
+    }
+
+    MaximaFrame *frame = new MaximaFrame;
+    frame->type = MR_SOCKET_LOST;
+    PushFrame(frame);
+    break;
+  }
+
+  return 0;
+}
+
+#endif // WXM_READER_THREAD
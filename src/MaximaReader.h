@@ -0,0 +1,110 @@
+///
+///  Copyright (C) 2013 The wxMaxima team
+///
+///  This program is free software; you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation; either version 2 of the License, or
+///  (at your option) any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program; if not, write to the Free Software
+///  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+///
+
+#ifndef _MAXIMAREADER_H_
+#define _MAXIMAREADER_H_
+
+#include <wx/wx.h>
+
+// Sockets can be used from a secondary thread only since wxWidgets 2.9
+#if wxUSE_THREADS && wxCHECK_VERSION(2, 9, 0)
+ #define WXM_READER_THREAD 1
+#else
+ #define WXM_READER_THREAD 0
+#endif
+
+#if WXM_READER_THREAD
+
+#include <wx/thread.h>
+#include <wx/socket.h>
+
+#include "MaximaStream.h"
+
+#define MR_QUEUE_SIZE 1024  // must be a power of two
+#define MR_POLL_TIME  10    // ms between checks for data to write
+
+#define MR_SOCKET_LOST -1   // frame type sent after the connection is lost
+
+/***
+ * A frame read from maxima.
+ */
+struct MaximaFrame
+{
+  int type;
+  std::string data;
+};
+
+/***
+ * A lock-free queue with exactly one producer and one consumer thread.
+ * m_tail is written only by the producer, m_head only by the consumer.
+ */
+class MaximaFrameQueue
+{
+public:
+  MaximaFrameQueue();
+  ~MaximaFrameQueue();
+  bool Push(MaximaFrame *frame);
+  MaximaFrame *Pop();
+private:
+  MaximaFrame *m_frames[MR_QUEUE_SIZE];
+  volatile size_t m_head;
+  volatile size_t m_tail;
+};
+
+wxDECLARE_EVENT(wxEVT_MAXIMA_READER, wxCommandEvent);
+
+/***
+ * MaximaReader owns the socket to maxima while it runs. It reads and frames
+ * the output in its own thread and hands complete frames to the GUI thread,
+ * which is woken up with a wxEVT_MAXIMA_READER event. Commands for maxima
+ * are collected in a buffer which the reader thread writes, so Write never
+ * waits for the reader thread.
+ */
+class MaximaReader : public wxThread
+{
+public:
+  MaximaReader(wxEvtHandler *handler, wxSocketBase *socket,
+               MaximaStream *stream);
+  ~MaximaReader();
+  // Called from the GUI thread
+  void Write(const char *data, size_t length);
+  MaximaFrame *GetFrame();
+  void FramesRead();
+  bool Start();
+  void Stop();
+protected:
+  virtual ExitCode Entry();
+private:
+  bool ReadSocket();
+  void PushFrame(MaximaFrame *frame);
+  void WritePending();
+  wxEvtHandler *m_handler;
+  wxSocketBase *m_socket;
+  MaximaStream *m_stream;
+  MaximaFrameQueue m_frames;  // from maxima to the GUI thread
+  wxCriticalSection m_writeLock;
+  std::string m_writeData;    // from the GUI thread to maxima
+  size_t m_readSize;
+  volatile bool m_stop;
+  volatile bool m_eventPending;
+};
+
+#endif // WXM_READER_THREAD
+
+#endif // _MAXIMAREADER_H_
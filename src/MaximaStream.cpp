@@ -0,0 +1,433 @@
+///
+///  Copyright (C) 2013 The wxMaxima team
+///
+///  This program is free software; you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation; either version 2 of the License, or
+///  (at your option) any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program; if not, write to the Free Software
+///  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+///
+
+#include "MaximaStream.h"
+
+#include <string.h>
+
+#define MS_INITIAL_SIZE 4096
+#define MS_SHRINK_SIZE  65536
+#define MS_FRAME_START  '\x02'   // STX - starts a frame in framed mode
+#define MS_MAX_DIGITS   10
+
+static const std::string mthEnd("</mth>");
+static const std::string symbolsStart("<wxxml-symbols>");
+static const std::string symbolsEnd("</wxxml-symbols>");
+static const std::string skipped("<wxxml-skipped/>");
+static const std::string lispError("dbl:MAXIMA>>"); // gcl
+
+MaximaStream::MaximaStream()
+{
+  m_size = MS_INITIAL_SIZE;
+  m_buffer = (char *)malloc(m_size);
+  m_start = m_scan = m_end = 0;
+  m_symbolsStart = 0;
+  m_state = m_stateBeforeSymbols = STATE_OUTPUT;
+  m_waitForFirstPrompt = false;
+  UpdateMarkerStart();
+}
+
+MaximaStream::~MaximaStream()
+{
+  free(m_buffer);
+}
+
+std::string MaximaStream::ToBytes(wxString str)
+{
+#if wxUSE_UNICODE
+  return std::string((const char *)str.utf8_str());
+#else
+  return std::string((const char *)str.c_str());
+#endif
+}
+
+void MaximaStream::SetPromptMarkers(wxString prefix, wxString suffix)
+{
+  m_promptPrefix = ToBytes(prefix);
+  m_promptSuffix = ToBytes(suffix);
+  UpdateMarkerStart();
+}
+
+/***
+ * Remember which bytes can start a marker - all other bytes are skipped
+ * with a single table lookup.
+ */
+void MaximaStream::UpdateMarkerStart()
+{
+  memset(m_markerStart, 0, sizeof(m_markerStart));
+  m_markerStart['<'] = true;
+  m_markerStart[(unsigned char)MS_FRAME_START] = true;
+  m_markerStart[(unsigned char)lispError[0]] = true;
+  if (m_promptPrefix.length())
+    m_markerStart[(unsigned char)m_promptPrefix[0]] = true;
+  if (m_promptSuffix.length())
+    m_markerStart[(unsigned char)m_promptSuffix[0]] = true;
+}
+
+void MaximaStream::Clear()
+{
+  m_start = m_scan = m_end = 0;
+  m_state = m_stateBeforeSymbols = STATE_OUTPUT;
+}
+
+/***
+ * Make room for length more bytes. The bytes of frames which were already
+ * handed out are dropped first, the buffer grows only if that is not enough.
+ */
+void MaximaStream::Reserve(size_t length)
+{
+  if (m_start > 0 && m_end + length > m_size)
+  {
+    memmove(m_buffer, m_buffer + m_start, m_end - m_start);
+    m_end -= m_start;
+    m_scan -= m_start;
+    m_symbolsStart = m_symbolsStart > m_start ? m_symbolsStart - m_start : 0;
+    m_start = 0;
+  }
+
+  if (m_end + length > m_size)
+  {
+    while (m_end + length > m_size)
+      m_size *= 2;
+    m_buffer = (char *)realloc(m_buffer, m_size);
+  }
+}
+
+void MaximaStream::Append(const char *data, size_t length)
+{
+  Reserve(length);
+  memcpy(m_buffer + m_end, data, length);
+  m_end += length;
+}
+
+/***
+ * Returns room for length bytes at the end of the buffer, so that the socket
+ * can be read without copying. Call Commit with the number of bytes actually
+ * written.
+ */
+char *MaximaStream::GetWriteBuffer(size_t length)
+{
+  Reserve(length);
+  return m_buffer + m_end;
+}
+
+/***
+ * Convert problematic characters in the new bytes into something sane,
+ * so that special character codes are not encountered unexpectedly
+ * (i.e. early).
+ */
+void MaximaStream::Commit(size_t length)
+{
+  for (size_t i = m_end; i < m_end + length; i++)
+  {
+    if (m_buffer[i] == 0)
+      m_buffer[i] = ' ';  // convert input null (0) to space (0x20)
+  }
+  m_end += length;
+}
+
+/***
+ * Gives the memory back after a large output has been read.
+ */
+void MaximaStream::Shrink()
+{
+  if (IsEmpty() && m_size > MS_SHRINK_SIZE)
+  {
+    m_size = MS_INITIAL_SIZE;
+    m_buffer = (char *)realloc(m_buffer, m_size);
+  }
+}
+
+/***
+ * Does marker start at pos? MATCH_PARTIAL means that the buffer ends before
+ * the marker could be checked completely.
+ */
+int MaximaStream::Match(size_t pos, const std::string& marker)
+{
+  size_t length = marker.length();
+  if (length == 0)
+    return MATCH_NONE;
+  size_t available = m_end - pos;
+  if (available > length)
+    available = length;
+  if (memcmp(m_buffer + pos, marker.data(), available) != 0)
+    return MATCH_NONE;
+  if (available < length)
+    return MATCH_PARTIAL;
+  return MATCH_FULL;
+}
+
+/***
+ * Does a frame header <STX><type><length>: start at pos? On MATCH_FULL type
+ * is the frame type, header the size of the header and length the size of
+ * the payload.
+ */
+int MaximaStream::MatchFrameHeader(size_t pos, int *type, size_t *header,
+                                   size_t *length)
+{
+  size_t i = pos + 1;
+  if (i == m_end)
+    return MATCH_PARTIAL;
+
+  switch (m_buffer[i])
+  {
+  case 'M':
+    *type = MS_FRAME_MATH;
+    break;
+  case 'P':
+    *type = MS_FRAME_PROMPT;
+    break;
+  case 'S':
+    *type = MS_FRAME_SYMBOLS;
+    break;
+  default:
+    return MATCH_NONE;
+  }
+
+  *length = 0;
+  for (i++; i < m_end && m_buffer[i] >= '0' && m_buffer[i] <= '9'; i++)
+  {
+    if (i - pos - 2 == MS_MAX_DIGITS)
+      return MATCH_NONE;
+    *length = *length * 10 + (m_buffer[i] - '0');
+  }
+
+  if (i == m_end)
+    return MATCH_PARTIAL;
+  if (i == pos + 2 || m_buffer[i] != ':')
+    return MATCH_NONE;
+
+  *header = i + 1 - pos;
+  return MATCH_FULL;
+}
+
+wxString MaximaStream::ToString(const std::string& bytes)
+{
+  if (bytes.empty())
+    return wxEmptyString;
+#if wxUSE_UNICODE
+  return wxString(bytes.data(), wxConvUTF8, bytes.length());
+#else
+  return wxString(bytes.data(), bytes.length());
+#endif
+}
+
+std::string MaximaStream::FrameData(size_t start, size_t end)
+{
+  if (end <= start)
+    return std::string();
+  return std::string(m_buffer + start, end - start);
+}
+
+/***
+ * Everything before pos has been handed out.
+ */
+void MaximaStream::Consume(size_t pos)
+{
+  m_start = m_scan = pos;
+  if (m_start == m_end)
+    m_start = m_scan = m_end = 0;
+}
+
+bool MaximaStream::NextFrame(int *type, wxString *data)
+{
+  std::string bytes;
+  if (!NextFrame(type, &bytes))
+    return false;
+  *data = ToString(bytes);
+  return true;
+}
+
+/***
+ * Returns the next complete frame read from maxima. Scanning resumes where
+ * the previous call stopped, so bytes are never scanned twice (except for
+ * the bytes which follow a <wxxml-symbols> block).
+ */
+bool MaximaStream::NextFrame(int *type, std::string *data)
+{
+  while (m_scan < m_end)
+  {
+    // Symbols are read up to the closing tag and then cut out of the buffer,
+    // the output around them is joined.
+    if (m_state == STATE_SYMBOLS)
+    {
+      int match = MATCH_NONE;
+      while (m_scan < m_end &&
+             (match = Match(m_scan, symbolsEnd)) == MATCH_NONE)
+        m_scan++;
+      if (match != MATCH_FULL)
+        return false;
+
+      *type = MS_FRAME_SYMBOLS;
+      *data = FrameData(m_symbolsStart + symbolsStart.length(), m_scan);
+
+      size_t rest = m_scan + symbolsEnd.length();
+      memmove(m_buffer + m_symbolsStart, m_buffer + rest, m_end - rest);
+      m_end -= rest - m_symbolsStart;
+      m_scan = m_symbolsStart;
+      m_state = m_stateBeforeSymbols;
+      if (m_start == m_end)
+        Consume(m_end);
+      return true;
+    }
+
+    if (!m_markerStart[(unsigned char)m_buffer[m_scan]] &&
+        !(m_waitForFirstPrompt && m_firstPrompt.length() &&
+          m_buffer[m_scan] == m_firstPrompt[0]))
+    {
+      m_scan++;
+      continue;
+    }
+
+    int match;
+    size_t pos = m_scan;
+
+    if (m_buffer[pos] == MS_FRAME_START)
+    {
+      int frameType;
+      size_t header, length;
+      match = MatchFrameHeader(pos, &frameType, &header, &length);
+      if (match == MATCH_PARTIAL)
+        return false;
+      if (match == MATCH_FULL)
+      {
+        if (m_end - pos - header < length)
+          return false;
+
+        // Math in a question stays part of the question: only the header
+        // is cut out.
+        if (m_state == STATE_PROMPT && frameType == MS_FRAME_MATH)
+        {
+          memmove(m_buffer + pos, m_buffer + pos + header,
+                  m_end - pos - header);
+          m_end -= header;
+          m_scan = pos + length;
+          continue;
+        }
+
+        // Output before the frame is handed out first.
+        if (pos > m_start)
+        {
+          *type = MS_FRAME_MATH;
+          *data = FrameData(m_start, pos);
+          Consume(pos);
+          return true;
+        }
+
+        *type = frameType;
+        *data = FrameData(pos + header, pos + header + length);
+        m_state = STATE_OUTPUT;
+        Consume(pos + header + length);
+        return true;
+      }
+    }
+
+    // The first prompt - everything read so far belongs to it.
+    if (m_waitForFirstPrompt &&
+        (match = Match(pos, m_firstPrompt)) != MATCH_NONE)
+    {
+      if (match == MATCH_PARTIAL)
+        return false;
+      m_waitForFirstPrompt = false;
+      *type = MS_FRAME_FIRST_PROMPT;
+      *data = FrameData(m_start, m_end);
+      m_state = STATE_OUTPUT;
+      Consume(m_end);
+      return true;
+    }
+
+    if ((match = Match(pos, symbolsStart)) != MATCH_NONE)
+    {
+      if (match == MATCH_PARTIAL)
+        return false;
+      m_stateBeforeSymbols = m_state;
+      m_state = STATE_SYMBOLS;
+      m_symbolsStart = pos;
+      m_scan = pos + symbolsStart.length();
+      continue;
+    }
+
+    if ((match = Match(pos, skipped)) != MATCH_NONE)
+    {
+      if (match == MATCH_PARTIAL)
+        return false;
+      // Output before the marker is handed out first.
+      if (pos > m_start)
+      {
+        *type = MS_FRAME_MATH;
+        *data = FrameData(m_start, pos);
+        Consume(pos);
+        return true;
+      }
+      *type = MS_FRAME_SKIPPED;
+      data->clear();
+      Consume(pos + skipped.length());
+      return true;
+    }
+
+    // Lisp debugger prompt - the rest of the buffer is dropped.
+    if ((match = Match(pos, lispError)) != MATCH_NONE)
+    {
+      if (match == MATCH_PARTIAL)
+        return false;
+      *type = MS_FRAME_LISP_ERROR;
+      *data = FrameData(m_start, pos);
+      m_state = STATE_OUTPUT;
+      Consume(m_end);
+      return true;
+    }
+
+    if ((match = Match(pos, m_promptPrefix)) != MATCH_NONE)
+    {
+      if (match == MATCH_PARTIAL)
+        return false;
+      *type = MS_FRAME_MATH;
+      *data = FrameData(m_start, pos);
+      m_state = STATE_PROMPT;
+      Consume(pos + m_promptPrefix.length());
+      return true;
+    }
+
+    if ((match = Match(pos, m_promptSuffix)) != MATCH_NONE)
+    {
+      if (match == MATCH_PARTIAL)
+        return false;
+      *type = MS_FRAME_PROMPT;
+      *data = FrameData(m_start, pos);
+      m_state = STATE_OUTPUT;
+      Consume(pos + m_promptSuffix.length());
+      return true;
+    }
+
+    if (m_state == STATE_OUTPUT &&
+        (match = Match(pos, mthEnd)) != MATCH_NONE)
+    {
+      if (match == MATCH_PARTIAL)
+        return false;
+      *type = MS_FRAME_MATH;
+      *data = FrameData(m_start, pos + mthEnd.length());
+      Consume(pos + mthEnd.length());
+      return true;
+    }
+
+    m_scan++;
+  }
+
+  return false;
+}
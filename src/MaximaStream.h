@@ -0,0 +1,106 @@
+///
+///  Copyright (C) 2013 The wxMaxima team
+///
+///  This program is free software; you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation; either version 2 of the License, or
+///  (at your option) any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program; if not, write to the Free Software
+///  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+///
+
+#ifndef _MAXIMASTREAM_H_
+#define _MAXIMASTREAM_H_
+
+#include <wx/wx.h>
+
+#include <string>
+
+#define SOCKET_SIZE 1024          // size of the first read from the socket
+#define SOCKET_SIZE_MAX 1048576   // reads grow up to this size
+
+enum {
+  MS_FRAME_FIRST_PROMPT,  // everything up to the first prompt of a session
+  MS_FRAME_MATH,          // output other than prompts
+  MS_FRAME_PROMPT,        // a main prompt or a question
+  MS_FRAME_SYMBOLS,       // contents of <wxxml-symbols>
+  MS_FRAME_LISP_ERROR,    // output before a lisp debugger prompt
+  MS_FRAME_SKIPPED        // an input of a pipelined run was dropped
+};
+
+/***
+ * MaximaStream collects the bytes maxima writes to the socket and splits
+ * them into frames.
+ *
+ * The bytes are kept in a growable buffer together with a scan cursor, so
+ * every byte is looked at only once no matter in how many pieces the output
+ * arrives. Markers are recognized in the raw (UTF-8) bytes and only complete
+ * frames are converted to wxString. All markers are ASCII, so a frame never
+ * ends inside a multibyte character, even if the character was split
+ * between two reads.
+ *
+ * If wxmathml.lisp runs in framed mode, math, main prompts and symbols
+ * arrive as <STX><type><length>:<payload>. The payload of these frames is
+ * skipped without looking for markers. Everything else (questions, lisp
+ * errors, older maxima) is still found with the markers.
+ */
+class MaximaStream
+{
+public:
+  MaximaStream();
+  ~MaximaStream();
+  void SetPromptMarkers(wxString prefix, wxString suffix);
+  void SetFirstPrompt(wxString prompt) { m_firstPrompt = ToBytes(prompt); }
+  void WaitForFirstPrompt(bool wait = true) { m_waitForFirstPrompt = wait; }
+  bool IsWaitingForFirstPrompt() { return m_waitForFirstPrompt; }
+  void Append(const char *data, size_t length);
+  char *GetWriteBuffer(size_t length);
+  void Commit(size_t length);
+  void Shrink();
+  bool NextFrame(int *type, wxString *data);
+  bool NextFrame(int *type, std::string *data);
+  void Clear();
+  bool IsEmpty() { return m_start == m_end; }
+  static std::string ToBytes(wxString str);
+  static wxString ToString(const std::string& bytes);
+private:
+  enum {
+    MATCH_NONE,
+    MATCH_PARTIAL,
+    MATCH_FULL
+  };
+  enum {
+    STATE_OUTPUT,
+    STATE_PROMPT,
+    STATE_SYMBOLS
+  };
+  int Match(size_t pos, const std::string& marker);
+  std::string FrameData(size_t start, size_t end);
+  void Consume(size_t pos);
+  void Reserve(size_t length);
+  void UpdateMarkerStart();
+  int MatchFrameHeader(size_t pos, int *type, size_t *header, size_t *length);
+  char *m_buffer;
+  size_t m_size;
+  size_t m_start;                 // start of the frame being read
+  size_t m_scan;                  // bytes before m_scan have been scanned
+  size_t m_end;                   // end of data in m_buffer
+  size_t m_symbolsStart;          // position of <wxxml-symbols>
+  int m_state;
+  int m_stateBeforeSymbols;
+  bool m_waitForFirstPrompt;
+  bool m_markerStart[256];        // first bytes of all markers
+  std::string m_promptPrefix;
+  std::string m_promptSuffix;
+  std::string m_firstPrompt;
+};
+
+#endif // _MAXIMASTREAM_H_
@@ -0,0 +1,124 @@
+///
+///  Copyright (C) 2013 The wxMaxima team
+///
+///  This program is free software; you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation; either version 2 of the License, or
+///  (at your option) any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program; if not, write to the Free Software
+///  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+///
+
+#include "MoreCell.h"
+#include "MathParser.h"
+
+MoreCell::MoreCell(wxString xml, int style) : TextCell()
+{
+  m_xml = xml;
+  m_pos = 0;
+  m_style = style;
+  ForceBreakLine(true);
+  UpdateText();
+}
+
+MathCell* MoreCell::Copy(bool all)
+{
+  MoreCell *tmp = new MoreCell(m_xml.Mid(m_pos), m_style);
+  CopyData(this, tmp);
+  tmp->m_forceBreakLine = m_forceBreakLine;
+  tmp->m_bigSkip = m_bigSkip;
+  if (all)
+    CopyNext(tmp);
+  return tmp;
+}
+
+void MoreCell::UpdateText()
+{
+  SetValue(wxString::Format(_(" << Show more (%lu characters not shown) >> "),
+                            (unsigned long)(m_xml.Length() - m_pos)));
+}
+
+/***
+ * The hidden part is saved unparsed, it is displayed in full when the
+ * document is loaded again.
+ */
+wxString MoreCell::ToXML(bool all)
+{
+  return m_xml.Mid(m_pos) + MathCell::ToXML(all);
+}
+
+/***
+ * Returns the end of the first top-level child which ends at least
+ * MORE_CHUNK_SIZE characters after start.
+ */
+size_t MoreCell::ChunkEnd(const wxString& xml, size_t start, size_t end)
+{
+  int depth = 0;
+  size_t i = start;
+
+  while (i < end)
+  {
+    if (xml[i] != wxT('<'))
+    {
+      i++;
+      continue;
+    }
+
+    bool closing = (i + 1 < end && xml[i + 1] == wxT('/'));
+    while (i < end && xml[i] != wxT('>'))
+      i++;
+    if (i == end)
+      break;
+
+    if (closing)
+      depth--;
+    else if (xml[i - 1] != wxT('/'))
+      depth++;
+    i++;
+
+    if (depth <= 0 && i - start >= MORE_CHUNK_SIZE)
+      return i;
+  }
+
+  return end;
+}
+
+/***
+ * Parses a part of a long output. A part which can't be parsed is replaced
+ * by an error, so that the rest can still be shown.
+ */
+MathCell* MoreCell::Parse(const wxString& xml, int style)
+{
+  MathParser parser;
+  MathCell *cell = parser.ParseLine(wxT("<span>") + xml + wxT("</span>"),
+                                    style, true);
+  if (cell == NULL)
+  {
+    cell = new TextCell(wxString::Format(_(" << %lu characters could not be displayed >> "),
+                                         (unsigned long)xml.Length()));
+    cell->SetType(MC_TYPE_ERROR);
+    cell->ForceBreakLine(true);
+  }
+  return cell;
+}
+
+/***
+ * Parses the next chunk of the hidden children. The caller inserts the
+ * cells before this cell.
+ */
+MathCell* MoreCell::ParseNext()
+{
+  size_t end = ChunkEnd(m_xml, m_pos, m_xml.Length());
+  MathCell *cell = Parse(m_xml.Mid(m_pos, end - m_pos), m_style);
+  m_pos = end;
+  UpdateText();
+  return cell;
+}
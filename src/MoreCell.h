@@ -0,0 +1,49 @@
+///
+///  Copyright (C) 2013 The wxMaxima team
+///
+///  This program is free software; you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation; either version 2 of the License, or
+///  (at your option) any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program; if not, write to the Free Software
+///  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+///
+
+#ifndef _MORECELL_H_
+#define _MORECELL_H_
+
+#include "TextCell.h"
+
+#define MORE_CHUNK_SIZE 20000  // characters of xml parsed by one "show more"
+
+/***
+ * MoreCell stands for the part of a long output which is not shown yet.
+ * It keeps the raw xml of the remaining top-level children of <mth> and
+ * parses them a chunk at a time when the user clicks it.
+ */
+class MoreCell : public TextCell
+{
+public:
+  MoreCell(wxString xml, int style);
+  MathCell* Copy(bool all);
+  wxString ToXML(bool all);
+  MathCell* ParseNext();
+  bool IsDone() { return m_pos >= m_xml.Length(); }
+  static size_t ChunkEnd(const wxString& xml, size_t start, size_t end);
+  static MathCell* Parse(const wxString& xml, int style);
+private:
+  void UpdateText();
+  wxString m_xml;     // children of <mth> which were not displayed
+  size_t m_pos;       // start of the first child not displayed
+  int m_style;
+};
+
+#endif // _MORECELL_H_
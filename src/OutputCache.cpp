@@ -0,0 +1,90 @@
+///
+///  Copyright (C) 2013 The wxMaxima team
+///
+///  This program is free software; you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation; either version 2 of the License, or
+///  (at your option) any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program; if not, write to the Free Software
+///  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+///
+
+
+#include "OutputCache.h"
+
+std::list<OutputCache::Entry> OutputCache::m_entries;
+std::map<GroupCell*, std::list<OutputCache::Entry>::iterator> OutputCache::m_index;
+long OutputCache::m_bytes = 0;
+long OutputCache::m_hits = 0;
+long OutputCache::m_rendered = 0;
+
+wxBitmap *OutputCache::Get(GroupCell *group, wxPoint point, bool outdated)
+{
+  std::map<GroupCell*, std::list<Entry>::iterator>::iterator it =
+    m_index.find(group);
+  if (it == m_index.end())
+    return NULL;
+
+  std::list<Entry>::iterator entry = it->second;
+  if (entry->point != point || entry->outdated != outdated)
+  {
+    Remove(group);
+    return NULL;
+  }
+
+  m_entries.splice(m_entries.begin(), m_entries, entry);
+  m_hits++;
+  return entry->bitmap;
+}
+
+void OutputCache::Add(GroupCell *group, wxBitmap *bitmap, wxPoint point, bool outdated)
+{
+  Remove(group);
+
+  Entry entry;
+  entry.group = group;
+  entry.bitmap = bitmap;
+  entry.point = point;
+  entry.outdated = outdated;
+  // 32 bits per pixel and the mask
+  entry.bytes = long(bitmap->GetWidth()) * bitmap->GetHeight() * 33 / 8;
+
+  m_entries.push_front(entry);
+  m_index[group] = m_entries.begin();
+  m_bytes += entry.bytes;
+  m_rendered++;
+
+  while (m_bytes > OUTPUT_CACHE_SIZE && m_entries.size() > 1)
+    Remove(m_entries.back().group);
+}
+
+void OutputCache::Remove(GroupCell *group)
+{
+  std::map<GroupCell*, std::list<Entry>::iterator>::iterator it =
+    m_index.find(group);
+  if (it == m_index.end())
+    return;
+
+  m_bytes -= it->second->bytes;
+  delete it->second->bitmap;
+  m_entries.erase(it->second);
+  m_index.erase(it);
+}
+
+void OutputCache::Clear()
+{
+  std::list<Entry>::iterator it;
+  for (it = m_entries.begin(); it != m_entries.end(); ++it)
+    delete it->bitmap;
+  m_entries.clear();
+  m_index.clear();
+  m_bytes = 0;
+}
@@ -0,0 +1,73 @@
+///
+///  Copyright (C) 2013 The wxMaxima team
+///
+///  This program is free software; you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation; either version 2 of the License, or
+///  (at your option) any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program; if not, write to the Free Software
+///  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+///
+
+
+#ifndef _OUTPUTCACHE_H_
+#define _OUTPUTCACHE_H_
+
+#include <wx/wx.h>
+
+#include <map>
+#include <list>
+
+#define OUTPUT_CACHE_SIZE (64*1024*1024) // bytes of cached output bitmaps
+#define OUTPUT_CACHE_MAX_HEIGHT 2048     // taller outputs are not cached
+
+class GroupCell;
+
+/***
+ * OutputCache keeps the output of groups rendered into bitmaps, so that
+ * drawing the output again (for a new tile, after a selection change, ...)
+ * is a single blit instead of drawing every cell.
+ *
+ * A bitmap is valid as long as the output is unchanged and is drawn at the
+ * same place: the cells remember where they were drawn for hit testing,
+ * so an output which moved is drawn again. GroupCell removes its bitmap
+ * when the output changes or is measured again (zoom, styles, width).
+ * The least recently used bitmaps are dropped when they take more than
+ * OUTPUT_CACHE_SIZE bytes.
+ */
+class OutputCache
+{
+public:
+  // returns NULL if the output of group was not drawn at point
+  static wxBitmap *Get(GroupCell *group, wxPoint point, bool outdated);
+  // the cache owns bitmap
+  static void Add(GroupCell *group, wxBitmap *bitmap, wxPoint point, bool outdated);
+  static void Remove(GroupCell *group);
+  static void Clear();
+  static long GetBytes() { return m_bytes; }
+  static long GetHits() { return m_hits; }
+  static long GetRendered() { return m_rendered; }
+private:
+  struct Entry
+  {
+    GroupCell *group;
+    wxBitmap *bitmap;
+    wxPoint point;
+    bool outdated;   // drawn with the outdated style
+    long bytes;
+  };
+  static std::list<Entry> m_entries;  // most recently used first
+  static std::map<GroupCell*, std::list<Entry>::iterator> m_index;
+  static long m_bytes;
+  static long m_hits, m_rendered;
+};
+
+#endif // _OUTPUTCACHE_H_
@@ -57,8 +57,7 @@ ParenCell::~ParenCell()
 {
   if (m_innerCell != NULL)
     delete m_innerCell;
-  if (m_next != NULL)
-    delete m_next;
+  DeleteNext();
   delete m_open;
   delete m_close;
 }
@@ -75,13 +74,20 @@ void ParenCell::SetParent(MathCell *parent, bool all)
   MathCell::SetParent(parent, all);
 }
 
+void ParenCell::GetInnerCells(std::vector<MathCell*>& cells)
+{
+  cells.push_back(m_innerCell);
+  cells.push_back(m_open);
+  cells.push_back(m_close);
+}
+
 MathCell* ParenCell::Copy(bool all)
 {
   ParenCell *tmp = new ParenCell;
   CopyData(this, tmp);
   tmp->SetInner(m_innerCell->Copy(true), m_type);
-  if (all && m_next != NULL)
-    tmp->AppendCell(m_next->Copy(all));
+  if (all)
+    CopyNext(tmp);
   return tmp;
 }
 
@@ -135,15 +141,15 @@ void ParenCell::RecalculateWidths(CellParser& parser, int fontsize, bool all)
       m_parenFontSize = fontsize;
       fontsize1 = (int) ((m_parenFontSize * scale + 0.5));
 
-      dc.SetFont(wxFont(fontsize1, wxFONTFAMILY_MODERN,
-                        false, false, false,
-                        m_bigParenType == 0 ?
-                          parser.GetTeXCMRI() :
-                            parser.GetTeXCMEX()));
-      dc.GetTextExtent(m_bigParenType == 0 ? wxT("(") :
-                       m_bigParenType == 1 ? wxT(PAREN_OPEN) :
-                                             wxT(PAREN_OPEN_TOP),
-                       &m_signWidth, &m_signSize);
+      dc.SetFont(FontCache::Get(fontsize1, wxFONTFAMILY_MODERN,
+                                false, false, false,
+                                m_bigParenType == 0 ?
+                                  parser.GetTeXCMRI() :
+                                    parser.GetTeXCMEX()));
+      FontCache::GetTextExtent(dc, m_bigParenType == 0 ? wxT("(") :
+                               m_bigParenType == 1 ? wxT(PAREN_OPEN) :
+                                                     wxT(PAREN_OPEN_TOP),
+                               &m_signWidth, &m_signSize);
 
       /// BUG 2897415: Exporting equations to HTML locks up on Mac
       ///  there is something wrong with what dc.GetTextExtent returns,
@@ -152,15 +158,15 @@ void ParenCell::RecalculateWidths(CellParser& parser, int fontsize, bool all)
       while (m_signSize < TRANSFORM_SIZE(m_bigParenType, size) && i<20)
       {
         int fontsize1 = (int) ((m_parenFontSize++ * scale + 0.5));
-        dc.SetFont(wxFont(fontsize1, wxFONTFAMILY_MODERN,
-                          false, false, false,
-                          m_bigParenType == 0 ?
-                             parser.GetTeXCMRI() :
-                               parser.GetTeXCMEX()));
-        dc.GetTextExtent(m_bigParenType == 0 ? wxT("(") :
-                         m_bigParenType == 1 ? wxT(PAREN_OPEN) :
-                                               wxT(PAREN_OPEN_TOP),
-                         &m_signWidth, &m_signSize);
+        dc.SetFont(FontCache::Get(fontsize1, wxFONTFAMILY_MODERN,
+                                  false, false, false,
+                                  m_bigParenType == 0 ?
+                                     parser.GetTeXCMRI() :
+                                       parser.GetTeXCMEX()));
+        FontCache::GetTextExtent(dc, m_bigParenType == 0 ? wxT("(") :
+                                 m_bigParenType == 1 ? wxT(PAREN_OPEN) :
+                                                       wxT(PAREN_OPEN_TOP),
+                                 &m_signWidth, &m_signSize);
         i++;
       }
     }
@@ -168,12 +174,12 @@ void ParenCell::RecalculateWidths(CellParser& parser, int fontsize, bool all)
     {
       m_parenFontSize = fontsize;
       fontsize1 = (int) ((m_parenFontSize * scale + 0.5));
-      dc.SetFont(wxFont(fontsize1, wxFONTFAMILY_MODERN,
-                        false, false, false,
-                        m_bigParenType < 1 ?
-                          parser.GetTeXCMRI() :
-                            parser.GetTeXCMEX()));
-      dc.GetTextExtent(wxT(PAREN_OPEN), &m_signWidth, &m_signSize);
+      dc.SetFont(FontCache::Get(fontsize1, wxFONTFAMILY_MODERN,
+                                false, false, false,
+                                m_bigParenType < 1 ?
+                                  parser.GetTeXCMRI() :
+                                    parser.GetTeXCMEX()));
+      FontCache::GetTextExtent(dc, wxT(PAREN_OPEN), &m_signWidth, &m_signSize);
     }
 
     m_signTop = m_signSize / 5;
@@ -184,12 +190,12 @@ void ParenCell::RecalculateWidths(CellParser& parser, int fontsize, bool all)
 #if defined __WXMSW__
     wxDC& dc = parser.GetDC();
     int fontsize1 = (int) ((PAREN_FONT_SIZE * scale + 0.5));
-    dc.SetFont(wxFont(fontsize1, wxFONTFAMILY_MODERN,
-                      parser.IsItalic(TS_DEFAULT),
-                      parser.IsBold(TS_DEFAULT),
-                      parser.IsUnderlined(TS_DEFAULT),
-                      parser.GetSymbolFontName()));
-    dc.GetTextExtent(wxT(PAREN_LEFT_TOP), &m_charWidth, &m_charHeight);
+    dc.SetFont(FontCache::Get(fontsize1, wxFONTFAMILY_MODERN,
+                              parser.IsItalic(TS_DEFAULT),
+                              parser.IsBold(TS_DEFAULT),
+                              parser.IsUnderlined(TS_DEFAULT),
+                              parser.GetSymbolFontName()));
+    FontCache::GetTextExtent(dc, wxT(PAREN_LEFT_TOP), &m_charWidth, &m_charHeight);
     m_width = m_innerCell->GetFullWidth(scale) + 2*m_charWidth;
 #else
     m_width = m_innerCell->GetFullWidth(scale) + SCALE_PX(12, parser.GetScale());
@@ -213,12 +219,12 @@ void ParenCell::RecalculateSize(CellParser& parser, int fontsize, bool all)
   {
     wxDC& dc = parser.GetDC();
     int fontsize1 = (int) ((fontsize * scale + 0.5));
-    dc.SetFont(wxFont(fontsize1, wxFONTFAMILY_MODERN,
-                      false,
-                      false,
-                      false,
-                      parser.GetFontName()));
-    dc.GetTextExtent(wxT("("), &m_charWidth1, &m_charHeight1);
+    dc.SetFont(FontCache::Get(fontsize1, wxFONTFAMILY_MODERN,
+                              false,
+                              false,
+                              false,
+                              parser.GetFontName()));
+    FontCache::GetTextExtent(dc, wxT("("), &m_charWidth1, &m_charHeight1);
   }
 #endif
 
@@ -240,11 +246,11 @@ void ParenCell::Draw(CellParser& parser, wxPoint point, int fontsize, bool all)
       in.x = point.x + m_signWidth;
       SetForeground(parser);
       int fontsize1 = (int) ((m_parenFontSize * scale + 0.5));
-      dc.SetFont(wxFont(fontsize1, wxFONTFAMILY_MODERN,
-                        false, false, false,
-                        m_bigParenType < 1 ?
-                          parser.GetTeXCMRI() :
-                            parser.GetTeXCMEX()));
+      dc.SetFont(FontCache::Get(fontsize1, wxFONTFAMILY_MODERN,
+                                false, false, false,
+                                m_bigParenType < 1 ?
+                                  parser.GetTeXCMRI() :
+                                    parser.GetTeXCMEX()));
       if (m_bigParenType < 2)
       {
         dc.DrawText(m_bigParenType == 0 ? wxT("(") :
@@ -298,11 +304,11 @@ void ParenCell::Draw(CellParser& parser, wxPoint point, int fontsize, bool all)
       if (m_height < (3*m_charHeight)/2)
       {
         fontsize1 = (int) ((fontsize * scale + 0.5));
-        dc.SetFont(wxFont(fontsize1, wxFONTFAMILY_MODERN,
-                          false,
-                          false,
-                          false,
-                          parser.GetFontName()));
+        dc.SetFont(FontCache::Get(fontsize1, wxFONTFAMILY_MODERN,
+                                  false,
+                                  false,
+                                  false,
+                                  parser.GetFontName()));
         dc.DrawText(wxT("("),
                     point.x + m_charWidth - m_charWidth1,
                     point.y - m_charHeight1 / 2);
@@ -312,11 +318,11 @@ void ParenCell::Draw(CellParser& parser, wxPoint point, int fontsize, bool all)
       }
       else
       {
-        dc.SetFont(wxFont(fontsize1, wxFONTFAMILY_MODERN,
-                          false,
-                          false,
-                          false,
-                          parser.GetSymbolFontName()));
+        dc.SetFont(FontCache::Get(fontsize1, wxFONTFAMILY_MODERN,
+                                  false,
+                                  false,
+                                  false,
+                                  parser.GetSymbolFontName()));
         dc.DrawText(wxT(PAREN_LEFT_TOP),
                     point.x,
                     point.y - m_center);
@@ -45,6 +45,7 @@ public:
   wxString ToTeX(bool all);
 	wxString ToXML(bool all);
   void SetParent(MathCell *parent, bool all);
+  void GetInnerCells(std::vector<MathCell*>& cells);
 protected:
   MathCell *m_innerCell, *m_open, *m_close;
   MathCell *m_last1;
@@ -0,0 +1,185 @@
+///
+///  Copyright (C) 2013 The wxMaxima team
+///
+///  This program is free software; you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation; either version 2 of the License, or
+///  (at your option) any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program; if not, write to the Free Software
+///  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+///
+
+#include "ParserPool.h"
+
+#if WXM_PARSER_THREADS
+
+#include "MathParser.h"
+#include "MathCell.h"
+
+wxDEFINE_EVENT(wxEVT_PARSER_POOL, wxCommandEvent);
+
+ParserPool::ParserPool(wxEvtHandler *handler) :
+  m_jobAdded(m_mutex), m_jobDone(m_mutex)
+{
+  m_handler = handler;
+  m_stop = false;
+}
+
+ParserPool::~ParserPool()
+{
+  Stop();
+}
+
+/***
+ * Starts the workers, by default one for each cpu.
+ */
+bool ParserPool::Start(int threads)
+{
+  if (threads < 1)
+    threads = wxThread::GetCPUCount();
+  if (threads < 1)
+    threads = 1;
+  if (threads > PP_MAX_THREADS)
+    threads = PP_MAX_THREADS;
+
+  for (int i = 0; i < threads; i++)
+  {
+    ParserWorker *worker = new ParserWorker(this);
+    if (worker->Create() != wxTHREAD_NO_ERROR ||
+        worker->Run() != wxTHREAD_NO_ERROR)
+    {
+      delete worker;
+      break;
+    }
+    m_workers.push_back(worker);
+  }
+
+  return m_workers.size() > 0;
+}
+
+/***
+ * Stops the workers. Jobs which were not fetched are dropped.
+ */
+void ParserPool::Stop()
+{
+  {
+    wxMutexLocker lock(m_mutex);
+    m_stop = true;
+    m_jobAdded.Broadcast();
+  }
+
+  for (unsigned int i = 0; i < m_workers.size(); i++)
+  {
+    m_workers[i]->Wait();
+    delete m_workers[i];
+  }
+  m_workers.clear();
+
+  while (!m_jobs.empty())
+  {
+    ParseJob *job = m_jobs.front();
+    m_jobs.pop_front();
+    if (job->cell != NULL)
+      delete job->cell;
+    delete job;
+  }
+  m_pending.clear();
+}
+
+void ParserPool::Add(wxString xml, int style, bool newLine, bool bigSkip,
+                     bool showLong, bool shareSubtrees)
+{
+  ParseJob *job = new ParseJob;
+  job->xml = xml;
+  job->style = style;
+  job->newLine = newLine;
+  job->bigSkip = bigSkip;
+  job->showLong = showLong;
+  job->shareSubtrees = shareSubtrees;
+  job->cell = NULL;
+  job->done = false;
+
+  m_jobs.push_back(job);
+
+  wxMutexLocker lock(m_mutex);
+  m_pending.push_back(job);
+  m_jobAdded.Signal();
+}
+
+/***
+ * Returns the oldest job if it is finished. With wait == true this waits
+ * until it is finished. Returns NULL if there are no jobs.
+ */
+ParseJob *ParserPool::GetResult(bool wait)
+{
+  if (m_jobs.empty())
+    return NULL;
+
+  ParseJob *job = m_jobs.front();
+  {
+    wxMutexLocker lock(m_mutex);
+    while (!job->done)
+    {
+      if (!wait)
+        return NULL;
+      m_jobDone.Wait();
+    }
+  }
+
+  m_jobs.pop_front();
+  return job;
+}
+
+/***
+ * Blocks until there is a job for the worker, returns NULL when the pool
+ * is stopped.
+ */
+ParseJob *ParserPool::NextJob()
+{
+  wxMutexLocker lock(m_mutex);
+  while (m_pending.empty() && !m_stop)
+    m_jobAdded.Wait();
+
+  if (m_stop)
+    return NULL;
+
+  ParseJob *job = m_pending.front();
+  m_pending.pop_front();
+  return job;
+}
+
+void ParserPool::JobDone(ParseJob *job)
+{
+  {
+    wxMutexLocker lock(m_mutex);
+    job->done = true;
+    m_jobDone.Broadcast();
+  }
+  wxQueueEvent(m_handler, new wxCommandEvent(wxEVT_PARSER_POOL));
+}
+
+wxThread::ExitCode ParserWorker::Entry()
+{
+  MathParser parser;
+  parser.SetWarnings(false);
+
+  ParseJob *job;
+  while ((job = m_pool->NextJob()) != NULL)
+  {
+    parser.SetShareSubtrees(job->shareSubtrees);
+    job->cell = parser.ParseLine(job->xml, job->style, job->showLong);
+    m_pool->JobDone(job);
+  }
+
+  return 0;
+}
+
+#endif // WXM_PARSER_THREADS
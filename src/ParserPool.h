@@ -0,0 +1,109 @@
+///
+///  Copyright (C) 2013 The wxMaxima team
+///
+///  This program is free software; you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation; either version 2 of the License, or
+///  (at your option) any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program; if not, write to the Free Software
+///  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+///
+
+#ifndef _PARSERPOOL_H_
+#define _PARSERPOOL_H_
+
+#include <wx/wx.h>
+
+// wxString can be passed between threads safely only since wxWidgets 2.9
+#if wxUSE_THREADS && wxCHECK_VERSION(2, 9, 0)
+ #define WXM_PARSER_THREADS 1
+#else
+ #define WXM_PARSER_THREADS 0
+#endif
+
+#if WXM_PARSER_THREADS
+
+#include <wx/thread.h>
+
+#include <deque>
+#include <vector>
+
+class MathCell;
+
+#define PP_MAX_THREADS 8
+
+/***
+ * An output which is parsed by the pool. The fields up to shareSubtrees are
+ * set by the GUI thread, cell is set by the worker.
+ */
+struct ParseJob
+{
+  wxString xml;
+  int style;
+  bool newLine;
+  bool bigSkip;
+  bool showLong;
+  bool shareSubtrees;
+  MathCell *cell;
+  bool done;
+};
+
+wxDECLARE_EVENT(wxEVT_PARSER_POOL, wxCommandEvent);
+
+class ParserWorker;
+
+/***
+ * ParserPool builds cell trees from maxima output on a few worker threads.
+ * Every worker has its own MathParser which doesn't read the configuration
+ * and doesn't open message boxes. Jobs can finish in any order, but
+ * GetResult returns them in the order they were added, so the output is
+ * inserted into the document in the order maxima sent it.
+ *
+ * The handler gets a wxEVT_PARSER_POOL event whenever a job is finished.
+ */
+class ParserPool
+{
+public:
+  ParserPool(wxEvtHandler *handler);
+  ~ParserPool();
+  bool Start(int threads = -1);
+  void Stop();
+  void Add(wxString xml, int style, bool newLine, bool bigSkip, bool showLong,
+           bool shareSubtrees);
+  ParseJob *GetResult(bool wait);
+  bool IsEmpty() { return m_jobs.empty(); }
+  // Called by the workers
+  ParseJob *NextJob();
+  void JobDone(ParseJob *job);
+private:
+  wxEvtHandler *m_handler;
+  wxMutex m_mutex;
+  wxCondition m_jobAdded;
+  wxCondition m_jobDone;
+  std::deque<ParseJob *> m_pending;  // jobs no worker has taken yet
+  std::deque<ParseJob *> m_jobs;     // all unfinished jobs, in output order
+  std::vector<ParserWorker *> m_workers;
+  bool m_stop;
+};
+
+class ParserWorker : public wxThread
+{
+public:
+  ParserWorker(ParserPool *pool) : wxThread(wxTHREAD_JOINABLE) { m_pool = pool; }
+protected:
+  virtual ExitCode Entry();
+private:
+  ParserPool *m_pool;
+};
+
+#endif // WXM_PARSER_THREADS
+
+#endif // _PARSERPOOL_H_
@@ -0,0 +1,216 @@
+///
+///  Copyright (C) 2013 The wxMaxima team
+///
+///  This program is free software; you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation; either version 2 of the License, or
+///  (at your option) any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program; if not, write to the Free Software
+///  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+///
+
+
+#include "SharedCell.h"
+
+wxAtomicInt SharedCell::m_trees = 0;
+wxAtomicInt SharedCell::m_cells = 0;
+
+SharedCell::SharedCell(MathCell *cell) : MathCell()
+{
+  Init(NewTree(cell));
+}
+
+SharedCell::SharedCell(SharedTree *tree) : MathCell()
+{
+  Init(tree);
+}
+
+void SharedCell::Init(SharedTree *tree)
+{
+  m_tree = tree;
+  Retain(m_tree);
+  m_type = m_tree->cell->GetType();
+  m_textStyle = m_tree->cell->GetStyle();
+  wxAtomicInc(m_cells);
+}
+
+SharedCell::~SharedCell()
+{
+  if (m_tree != NULL)
+  {
+    Release(m_tree);
+    wxAtomicDec(m_cells);
+  }
+  DeleteNext();
+}
+
+/***
+ * Makes a tree of cell, which must be a single cell. The counts are not
+ * locked: a tree is built by one parser and is only used by the GUI thread
+ * after the output is inserted.
+ */
+SharedTree *SharedCell::NewTree(MathCell *cell)
+{
+  SharedTree *tree = new SharedTree;
+  tree->cell = cell;
+  tree->count = 0;
+  tree->fontsize = -1;
+  tree->scale = 0;
+  tree->pass = 0;
+  tree->sized = false;
+  wxAtomicInc(m_trees);
+  return tree;
+}
+
+void SharedCell::Release(SharedTree *tree)
+{
+  if (--tree->count > 0)
+    return ;
+  delete tree->cell;
+  delete tree;
+  wxAtomicDec(m_trees);
+}
+
+MathCell* SharedCell::Copy(bool all)
+{
+  SharedCell* tmp = new SharedCell(m_tree);
+  CopyData(this, tmp);
+  if (all)
+    CopyNext(tmp);
+  return tmp;
+}
+
+void SharedCell::Destroy()
+{
+  if (m_tree != NULL)
+  {
+    Release(m_tree);
+    wxAtomicDec(m_cells);
+  }
+  m_tree = NULL;
+  m_next = NULL;
+}
+
+void SharedCell::SetParent(MathCell *parent, bool all)
+{
+  m_tree->cell->SetParent(parent, false);
+  MathCell::SetParent(parent, all);
+}
+
+void SharedCell::GetInnerCells(std::vector<MathCell*>& cells)
+{
+  cells.push_back(m_tree->cell);
+}
+
+/***
+ * The flag changes how the subtree is drawn, so this occurrence gets its
+ * own copy unless it is the only user.
+ */
+void SharedCell::SetExponentFlag()
+{
+  if (m_tree->count > 1)
+  {
+    MathCell *cell = m_tree->cell->Copy(false);
+    Release(m_tree);
+    wxAtomicDec(m_cells);
+    Init(NewTree(cell));
+  }
+  m_tree->cell->SetExponentFlag();
+}
+
+/***
+ * The subtree has the widths for fontsize. A forced update measures it once
+ * per pass, not once per occurrence.
+ */
+bool SharedCell::IsMeasured(CellParser& parser, int fontsize)
+{
+  return m_tree->fontsize == fontsize && m_tree->scale == parser.GetScale() &&
+         (!parser.ForceUpdate() || m_tree->pass == parser.GetPass());
+}
+
+/***
+ * Measures the widths of the subtree for fontsize. The cells of the
+ * subtree only compare the font size with the last one, so they are forced
+ * when the scale changed.
+ */
+void SharedCell::Measure(CellParser& parser, int fontsize)
+{
+  bool force = parser.ForceUpdate();
+  if (m_tree->scale != parser.GetScale())
+    parser.SetForceUpdate(true);
+  m_tree->cell->RecalculateWidths(parser, fontsize, false);
+  parser.SetForceUpdate(force);
+
+  m_tree->fontsize = fontsize;
+  m_tree->scale = parser.GetScale();
+  m_tree->pass = parser.GetPass();
+  m_tree->sized = false;
+}
+
+void SharedCell::RecalculateWidths(CellParser& parser, int fontsize, bool all)
+{
+  if (!IsMeasured(parser, fontsize))
+    Measure(parser, fontsize);
+  m_width = m_tree->cell->GetWidth();
+  MathCell::RecalculateWidths(parser, fontsize, all);
+}
+
+/***
+ * Another occurrence of another size may have been measured since the
+ * widths of this one, the height depends on the widths pass.
+ */
+void SharedCell::RecalculateSize(CellParser& parser, int fontsize, bool all)
+{
+  if (!IsMeasured(parser, fontsize))
+    Measure(parser, fontsize);
+  if (!m_tree->sized)
+  {
+    m_tree->cell->RecalculateSize(parser, fontsize, false);
+    m_tree->sized = true;
+  }
+  m_height = m_tree->cell->GetHeight();
+  m_center = m_tree->cell->GetCenter();
+  MathCell::RecalculateSize(parser, fontsize, all);
+}
+
+void SharedCell::Draw(CellParser& parser, wxPoint point, int fontsize, bool all)
+{
+  if (DrawThisCell(parser, point))
+  {
+    // Another occurrence of the subtree may have a different size
+    if (m_tree->fontsize != fontsize || m_tree->scale != parser.GetScale() ||
+        !m_tree->sized)
+    {
+      Measure(parser, fontsize);
+      m_tree->cell->RecalculateSize(parser, fontsize, false);
+      m_tree->sized = true;
+    }
+    m_tree->cell->Draw(parser, point, fontsize, false);
+  }
+  MathCell::Draw(parser, point, fontsize, all);
+}
+
+wxString SharedCell::ToString(bool all)
+{
+  if (m_altCopyText != wxEmptyString)
+    return m_altCopyText + MathCell::ToString(all);
+  return m_tree->cell->ToString(false) + MathCell::ToString(all);
+}
+
+wxString SharedCell::ToTeX(bool all)
+{
+  return m_tree->cell->ToTeX(false) + MathCell::ToTeX(all);
+}
+
+wxString SharedCell::ToXML(bool all)
+{
+  return m_tree->cell->ToXML(false) + MathCell::ToXML(all);
+}
@@ -0,0 +1,86 @@
+///
+///  Copyright (C) 2013 The wxMaxima team
+///
+///  This program is free software; you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation; either version 2 of the License, or
+///  (at your option) any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program; if not, write to the Free Software
+///  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+///
+
+
+#ifndef _SHAREDCELL_H_
+#define _SHAREDCELL_H_
+
+#include <wx/atomic.h>
+
+#include "MathCell.h"
+
+/***
+ * A subtree which is used by several SharedCells. It is a single cell, not
+ * a list, and is not changed after it is parsed. It remembers for which
+ * font size, scale and layout pass it was measured last, so that it is
+ * measured once however often it occurs.
+ */
+struct SharedTree
+{
+  MathCell *cell;
+  int count;        // the SharedCells (and the MathParser) which use it
+  int fontsize;     // of the last RecalculateWidths
+  double scale;
+  long pass;        // CellParser::GetPass of the last RecalculateWidths
+  bool sized;       // RecalculateSize ran after RecalculateWidths
+};
+
+/***
+ * SharedCell is an occurrence of a subtree which repeats in an output (see
+ * MathParser::ParseShared). Each occurrence has its own position and place
+ * in the list, but the cells of the subtree exist once. The subtree is
+ * drawn at the position of each SharedCell which is drawn.
+ *
+ * The cells of the subtree can't be selected on their own and the subtree
+ * is never broken into lines, so only small subtrees are shared.
+ */
+class SharedCell : public MathCell
+{
+public:
+  SharedCell(MathCell *cell);
+  SharedCell(SharedTree *tree);
+  ~SharedCell();
+  MathCell* Copy(bool all);
+  void Destroy();
+  void RecalculateWidths(CellParser& parser, int fontsize, bool all);
+  void RecalculateSize(CellParser& parser, int fontsize, bool all);
+  void Draw(CellParser& parser, wxPoint point, int fontsize, bool all);
+  wxString ToString(bool all);
+  wxString ToTeX(bool all);
+  wxString ToXML(bool all);
+  void SetParent(MathCell *parent, bool all);
+  void GetInnerCells(std::vector<MathCell*>& cells);
+  void SetExponentFlag();
+  bool IsOperator() { return m_tree->cell->IsOperator(); }
+  bool IsShortNum() { return m_tree->cell->IsShortNum(); }
+  SharedTree *GetTree() { return m_tree; }
+  static void Retain(SharedTree *tree) { tree->count++; }
+  static void Release(SharedTree *tree);
+  static long GetTrees() { return m_trees; }
+  static long GetCells() { return m_cells; }
+protected:
+  static SharedTree *NewTree(MathCell *cell);
+  void Init(SharedTree *tree);
+  bool IsMeasured(CellParser& parser, int fontsize);
+  void Measure(CellParser& parser, int fontsize);
+  SharedTree *m_tree;
+  static wxAtomicInt m_trees, m_cells;
+};
+
+#endif // _SHAREDCELL_H_
@@ -38,8 +38,7 @@ SlideShow::~SlideShow()
 {
   for (int i=0; i<m_size; i++)
     delete m_bitmaps[i];
-  if (m_next != NULL)
-    delete m_next;
+  DeleteNext();
 }
 
 void SlideShow::LoadImages(wxArrayString images)
@@ -139,8 +138,8 @@ MathCell* SlideShow::Copy(bool all)
 
   tmp->m_bitmap = new wxBitmap(*m_bitmaps[m_displayed]);
 
-  if (all && m_next != NULL)
-    tmp->AppendCell(m_next->Copy(all));
+  if (all)
+    CopyNext(tmp);
   return tmp;
 }
 
@@ -0,0 +1,43 @@
+///
+///  Copyright (C) 2013 The wxMaxima team
+///
+///  This program is free software; you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation; either version 2 of the License, or
+///  (at your option) any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program; if not, write to the Free Software
+///  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+///
+
+#include "SpoolCell.h"
+
+SpoolCell::SpoolCell(wxString file, long lines, long bytes) : TextCell()
+{
+  m_file = file;
+  m_lines = lines;
+  m_bytes = bytes;
+  SetType(MC_TYPE_ERROR);
+  ForceBreakLine(true);
+  SetValue(wxString::Format(_(" << Too much output: %ld lines (%ld characters) were"
+                              " written to a file, click to open it >> "),
+                            lines, bytes));
+}
+
+MathCell* SpoolCell::Copy(bool all)
+{
+  SpoolCell *tmp = new SpoolCell(m_file, m_lines, m_bytes);
+  CopyData(this, tmp);
+  tmp->m_forceBreakLine = m_forceBreakLine;
+  tmp->m_bigSkip = m_bigSkip;
+  if (all)
+    CopyNext(tmp);
+  return tmp;
+}
@@ -0,0 +1,42 @@
+///
+///  Copyright (C) 2013 The wxMaxima team
+///
+///  This program is free software; you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation; either version 2 of the License, or
+///  (at your option) any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program; if not, write to the Free Software
+///  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+///
+
+#ifndef _SPOOLCELL_H_
+#define _SPOOLCELL_H_
+
+#include "TextCell.h"
+
+/***
+ * SpoolCell is shown in place of output which was written to a file
+ * because maxima sent more than the flood control allows. Clicking it
+ * opens the file.
+ */
+class SpoolCell : public TextCell
+{
+public:
+  SpoolCell(wxString file, long lines, long bytes);
+  MathCell* Copy(bool all);
+  wxString GetFile() { return m_file; }
+private:
+  wxString m_file;
+  long m_lines;
+  long m_bytes;
+};
+
+#endif // _SPOOLCELL_H_
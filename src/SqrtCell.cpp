@@ -34,8 +34,7 @@ SqrtCell::~SqrtCell()
 {
   if (m_innerCell != NULL)
     delete m_innerCell;
-  if (m_next != NULL)
-    delete m_next;
+  DeleteNext();
   delete m_open;
   delete m_close;
 }
@@ -52,13 +51,20 @@ void SqrtCell::SetParent(MathCell *parent, bool all)
   MathCell::SetParent(parent, all);
 }
 
+void SqrtCell::GetInnerCells(std::vector<MathCell*>& cells)
+{
+  cells.push_back(m_innerCell);
+  cells.push_back(m_open);
+  cells.push_back(m_close);
+}
+
 MathCell* SqrtCell::Copy(bool all)
 {
   SqrtCell* tmp = new SqrtCell;
   CopyData(this, tmp);
   tmp->SetInner(m_innerCell->Copy(true));
-  if (all && m_next != NULL)
-    tmp->AppendCell(m_next->Copy(all));
+  if (all)
+    CopyNext(tmp);
   return tmp;
 }
 
@@ -96,8 +102,8 @@ void SqrtCell::RecalculateWidths(CellParser& parser, int fontsize, bool all)
     m_signFontScale = 1.0;
     int fontsize1 = (int)(SIGN_FONT_SCALE*scale*fontsize*m_signFontScale + 0.5);
 
-    dc.SetFont(wxFont(fontsize1, wxFONTFAMILY_MODERN, false, false, false, parser.GetTeXCMEX()));
-    dc.GetTextExtent(wxT("s"), &m_signWidth, &m_signSize);
+    dc.SetFont(FontCache::Get(fontsize1, wxFONTFAMILY_MODERN, false, false, false, parser.GetTeXCMEX()));
+    FontCache::GetTextExtent(dc, wxT("s"), &m_signWidth, &m_signSize);
     m_signTop = m_signSize / 5;
     m_width = m_innerCell->GetFullWidth(scale) + m_signWidth;
 
@@ -125,8 +131,8 @@ void SqrtCell::RecalculateWidths(CellParser& parser, int fontsize, bool all)
     }
 
     fontsize1 = (int)(SIGN_FONT_SCALE*scale*fontsize*m_signFontScale + 0.5);
-    dc.SetFont(wxFont(fontsize1, wxFONTFAMILY_MODERN, false, false, false, parser.GetTeXCMEX()));
-    dc.GetTextExtent(wxT("s"), &m_signWidth, &m_signSize);
+    dc.SetFont(FontCache::Get(fontsize1, wxFONTFAMILY_MODERN, false, false, false, parser.GetTeXCMEX()));
+    FontCache::GetTextExtent(dc, wxT("s"), &m_signWidth, &m_signSize);
     m_signTop = m_signSize / 5;
     m_width = m_innerCell->GetFullWidth(scale) + m_signWidth;
   }
@@ -167,7 +173,7 @@ void SqrtCell::Draw(CellParser& parser, wxPoint point, int fontsize, bool all)
 
       int fontsize1 = (int)(SIGN_FONT_SCALE*scale*fontsize*m_signFontScale + 0.5);
 
-      dc.SetFont(wxFont(fontsize1, wxFONTFAMILY_MODERN, false, false, false, parser.GetTeXCMEX()));
+      dc.SetFont(FontCache::Get(fontsize1, wxFONTFAMILY_MODERN, false, false, false, parser.GetTeXCMEX()));
       SetForeground(parser);
       if (m_signType < 4) {
         dc.DrawText(
@@ -40,6 +40,7 @@ public:
   wxString ToTeX(bool all);
 	wxString ToXML(bool all);	//new!!
   void SetParent(MathCell *parent, bool all);
+  void GetInnerCells(std::vector<MathCell*>& cells);
 protected:
   MathCell *m_innerCell;
   MathCell *m_open, *m_close, *m_last;
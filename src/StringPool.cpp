@@ -0,0 +1,53 @@
+///
+///  Copyright (C) 2013 The wxMaxima team
+///
+///  This program is free software; you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation; either version 2 of the License, or
+///  (at your option) any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program; if not, write to the Free Software
+///  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+///
+
+
+#include "StringPool.h"
+
+#include <set>
+
+#if wxUSE_THREADS
+#include <wx/thread.h>
+
+static wxCriticalSection poolLock;
+#endif
+
+static std::set<wxString> strings;
+
+const wxString *StringPool::Intern(const wxString& str)
+{
+  if (str.IsEmpty())
+    return NULL;
+
+#if wxUSE_THREADS
+  wxCriticalSectionLocker lock(poolLock);
+#endif
+
+  // Elements of a set don't move, so the pointer stays valid
+  return &*strings.insert(str).first;
+}
+
+long StringPool::GetCount()
+{
+#if wxUSE_THREADS
+  wxCriticalSectionLocker lock(poolLock);
+#endif
+
+  return strings.size();
+}
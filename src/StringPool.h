@@ -0,0 +1,40 @@
+///
+///  Copyright (C) 2013 The wxMaxima team
+///
+///  This program is free software; you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation; either version 2 of the License, or
+///  (at your option) any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program; if not, write to the Free Software
+///  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+///
+
+
+#ifndef _STRINGPOOL_H_
+#define _STRINGPOOL_H_
+
+#include <wx/wx.h>
+
+/***
+ * StringPool keeps a single copy of strings which many cells share, like
+ * font names and the glyphs which replace greek letters and symbols. The
+ * cells keep pointers to the interned strings. Interned strings are never
+ * freed, so only strings from a small set should be interned.
+ */
+class StringPool
+{
+public:
+  // Returns NULL for the empty string
+  static const wxString *Intern(const wxString& str);
+  static long GetCount();
+};
+
+#endif // _STRINGPOOL_H_
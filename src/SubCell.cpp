@@ -33,8 +33,7 @@ SubCell::~SubCell()
     delete m_baseCell;
   if (m_indexCell != NULL)
     delete m_indexCell;
-  if (m_next != NULL)
-    delete m_next;
+  DeleteNext();
 }
 
 void SubCell::SetParent(MathCell *parent, bool all)
@@ -47,14 +46,20 @@ void SubCell::SetParent(MathCell *parent, bool all)
   MathCell::SetParent(parent, all);
 }
 
+void SubCell::GetInnerCells(std::vector<MathCell*>& cells)
+{
+  cells.push_back(m_baseCell);
+  cells.push_back(m_indexCell);
+}
+
 MathCell* SubCell::Copy(bool all)
 {
   SubCell* tmp = new SubCell;
   CopyData(this, tmp);
   tmp->SetBase(m_baseCell->Copy(true));
   tmp->SetIndex(m_indexCell->Copy(true));
-  if (all && m_next != NULL)
-    tmp->AppendCell(m_next->Copy(all));
+  if (all)
+    CopyNext(tmp);
   return tmp;
 }
 
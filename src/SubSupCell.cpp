@@ -35,8 +35,7 @@ SubSupCell::~SubSupCell()
     delete m_indexCell;
   if (m_exptCell != NULL)
     delete m_exptCell;
-  if (m_next != NULL)
-    delete m_next;
+  DeleteNext();
 }
 
 void SubSupCell::SetParent(MathCell *parent, bool all)
@@ -51,6 +50,13 @@ void SubSupCell::SetParent(MathCell *parent, bool all)
   MathCell::SetParent(parent, all);
 }
 
+void SubSupCell::GetInnerCells(std::vector<MathCell*>& cells)
+{
+  cells.push_back(m_baseCell);
+  cells.push_back(m_indexCell);
+  cells.push_back(m_exptCell);
+}
+
 MathCell* SubSupCell::Copy(bool all)
 {
   SubSupCell* tmp = new SubSupCell;
@@ -58,8 +64,8 @@ MathCell* SubSupCell::Copy(bool all)
   tmp->SetBase(m_baseCell->Copy(true));
   tmp->SetIndex(m_indexCell->Copy(true));
   tmp->SetExponent(m_exptCell->Copy(true));
-  if (all && m_next != NULL)
-    tmp->AppendCell(m_next->Copy(all));
+  if (all)
+    CopyNext(tmp);
   return tmp;
 }
 
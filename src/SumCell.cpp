@@ -43,8 +43,7 @@ SumCell::~SumCell()
     delete m_under;
   if (m_over != NULL)
     delete m_over;
-  if (m_next != NULL)
-    delete m_next;
+  DeleteNext();
 }
 
 void SumCell::SetParent(MathCell *parent, bool all)
@@ -59,6 +58,13 @@ void SumCell::SetParent(MathCell *parent, bool all)
   MathCell::SetParent(parent, all);
 }
 
+void SumCell::GetInnerCells(std::vector<MathCell*>& cells)
+{
+  cells.push_back(m_base);
+  cells.push_back(m_under);
+  cells.push_back(m_over);
+}
+
 MathCell* SumCell::Copy(bool all)
 {
   SumCell *tmp = new SumCell;
@@ -67,8 +73,8 @@ MathCell* SumCell::Copy(bool all)
   tmp->SetUnder(m_under->Copy(true));
   tmp->SetOver(m_over->Copy(true));
   tmp->m_sumStyle = m_sumStyle;
-  if (all && m_next != NULL)
-    tmp->AppendCell(m_next->Copy(all));
+  if (all)
+    CopyNext(tmp);
   return tmp;
 }
 
@@ -131,10 +137,10 @@ void SumCell::RecalculateWidths(CellParser& parser, int fontsize, bool all)
   {
     wxDC& dc = parser.GetDC();
     int fontsize1 = (int) ((fontsize * 1.5 * scale + 0.5));
-    dc.SetFont(wxFont(fontsize1, wxFONTFAMILY_MODERN,
-                      false, false, false,
-                      parser.GetTeXCMEX()));
-    dc.GetTextExtent(m_sumStyle == SM_SUM ? wxT(SUM_SIGN) : wxT(PROD_SIGN), &m_signWidth, &m_signSize);
+    dc.SetFont(FontCache::Get(fontsize1, wxFONTFAMILY_MODERN,
+                              false, false, false,
+                              parser.GetTeXCMEX()));
+    FontCache::GetTextExtent(dc, m_sumStyle == SM_SUM ? wxT(SUM_SIGN) : wxT(PROD_SIGN), &m_signWidth, &m_signSize);
     m_signWCenter = m_signWidth / 2;
     m_signTop = (2* m_signSize) / 5;
     m_signSize = (2 * m_signSize) / 5;
@@ -184,9 +190,9 @@ void SumCell::Draw(CellParser& parser, wxPoint point, int fontsize, bool all)
     {
       SetForeground(parser);
       int fontsize1 = (int) ((fontsize * 1.5 * scale + 0.5));
-      dc.SetFont(wxFont(fontsize1, wxFONTFAMILY_MODERN,
-                        false, false, false,
-                        parser.GetTeXCMEX()));
+      dc.SetFont(FontCache::Get(fontsize1, wxFONTFAMILY_MODERN,
+                                false, false, false,
+                                parser.GetTeXCMEX()));
       dc.DrawText(m_sumStyle == SM_SUM ? wxT(SUM_SIGN) : wxT(PROD_SIGN),
                   sign.x + m_signWCenter - m_signWidth / 2,
                   sign.y - m_signTop);
@@ -20,26 +20,55 @@
 #include "TextCell.h"
 #include "Setup.h"
 
+#include <wx/hashmap.h>
+
+#if wxUSE_THREADS
+#include <wx/thread.h>
+#endif
+
+/***
+ * The glyphs which replace a text in SetAltText, interned in the
+ * StringPool. They are NULL where the text has no replacement.
+ */
+struct TextSymbol
+{
+  const wxString *greek, *greekJs, *greekJsFont;  // for greek constants
+  const wxString *symbol, *symbolPercent;        // without and with keepPercent
+  const wxString *symbolJs, *symbolJsFont;
+  const wxString *font;                          // the font of greek and symbol
+};
+
+WX_DECLARE_STRING_HASH_MAP(TextSymbol, TextSymbols);
+
+// Built by the first FindSymbol, TextCells are created by parser threads
+static TextSymbols *symbols = NULL;
+#if wxUSE_THREADS
+static wxCriticalSection symbolsLock;
+#endif
+
 TextCell::TextCell() : MathCell()
 {
   m_text = wxEmptyString;
+  m_symbol = NULL;
   m_fontSize = -1;
   m_highlight = false;
-  m_altJs = m_alt = false;
+  m_altText = m_altJsText = NULL;
+  m_fontname = m_texFontname = NULL;
 }
 
 TextCell::TextCell(wxString text) : MathCell()
 {
   m_text = text;
   m_text.Replace(wxT("\n"), wxEmptyString);
+  m_symbol = FindSymbol(m_text);
   m_highlight = false;
-  m_altJs = m_alt = false;
+  m_altText = m_altJsText = NULL;
+  m_fontname = m_texFontname = NULL;
 }
 
 TextCell::~TextCell()
 {
-  if (m_next != NULL)
-    delete m_next;
+  DeleteNext();
 }
 
 void TextCell::SetValue(wxString text)
@@ -47,7 +76,8 @@ void TextCell::SetValue(wxString text)
   m_text = text;
   m_width = -1;
   m_text.Replace(wxT("\n"), wxEmptyString);
-  m_alt = m_altJs = false;
+  m_symbol = FindSymbol(m_text);
+  m_altText = m_altJsText = NULL;
 }
 
 MathCell* TextCell::Copy(bool all)
@@ -55,13 +85,14 @@ MathCell* TextCell::Copy(bool all)
   TextCell *tmp = new TextCell(wxEmptyString);
   CopyData(this, tmp);
   tmp->m_text = wxString(m_text);
+  tmp->m_symbol = m_symbol;
   tmp->m_forceBreakLine = m_forceBreakLine;
   tmp->m_bigSkip = m_bigSkip;
   tmp->m_isHidden = m_isHidden;
   tmp->m_textStyle = m_textStyle;
   tmp->m_highlight = m_highlight;
-  if (all && m_next != NULL)
-    tmp->AppendCell(m_next->Copy(all));
+  if (all)
+    CopyNext(tmp);
   return tmp;
 }
 
@@ -87,48 +118,48 @@ void TextCell::RecalculateWidths(CellParser& parser, int fontsize, bool all)
     if ((m_textStyle == TS_LABEL) || (m_textStyle == TS_MAIN_PROMPT)) {
 	  // Check for output annotations (/R/ for CRE and /T/ for Taylor expressions)
       if (m_text.Right(2) != wxT("/ "))
-        dc.GetTextExtent(wxT("(\%oXXX)"), &m_width, &m_height);
+        FontCache::GetTextExtent(dc, wxT("(\%oXXX)"), &m_width, &m_height);
       else
-        dc.GetTextExtent(wxT("(\%oXXX)/R/"), &m_width, &m_height);
+        FontCache::GetTextExtent(dc, wxT("(\%oXXX)/R/"), &m_width, &m_height);
       m_fontSizeLabel = m_fontSize;
-      dc.GetTextExtent(m_text, &m_labelWidth, &m_labelHeight);
+      FontCache::GetTextExtent(dc, m_text, &m_labelWidth, &m_labelHeight);
       while (m_labelWidth >= m_width) {
         int fontsize1 = (int) (((double) --m_fontSizeLabel) * scale + 0.5);
-        dc.SetFont(wxFont(fontsize1, wxFONTFAMILY_MODERN,
-              parser.IsItalic(m_textStyle),
-              parser.IsBold(m_textStyle),
-              false, //parser.IsUnderlined(m_textStyle),
-              parser.GetFontName(m_textStyle),
-              parser.GetFontEncoding()));
-        dc.GetTextExtent(m_text, &m_labelWidth, &m_labelHeight);
+        dc.SetFont(FontCache::Get(fontsize1, wxFONTFAMILY_MODERN,
+                                  parser.IsItalic(m_textStyle),
+                                  parser.IsBold(m_textStyle),
+                                  false, //parser.IsUnderlined(m_textStyle),
+                                  parser.GetFontName(m_textStyle),
+                                  parser.GetFontEncoding()));
+        FontCache::GetTextExtent(dc, m_text, &m_labelWidth, &m_labelHeight);
       }
     }
 
     /// Check if we are using jsMath and have jsMath character
-    else if (m_altJs && parser.CheckTeXFonts())
+    else if (m_altJsText != NULL && parser.CheckTeXFonts())
     {
-      dc.GetTextExtent(m_altJsText, &m_width, &m_height);
+      FontCache::GetTextExtent(dc, *m_altJsText, &m_width, &m_height);
 
-      if (m_texFontname == wxT("jsMath-cmsy10"))
+      if (*m_texFontname == wxT("jsMath-cmsy10"))
         m_height = m_height / 2;
     }
 
     /// We are using a special symbol
-    else if (m_alt)
+    else if (m_altText != NULL)
     {
-      dc.GetTextExtent(m_altText, &m_width, &m_height);
+      FontCache::GetTextExtent(dc, *m_altText, &m_width, &m_height);
     }
 
     /// Empty string has height of X
     else if (m_text == wxEmptyString)
     {
-      dc.GetTextExtent(wxT("X"), &m_width, &m_height);
+      FontCache::GetTextExtent(dc, wxT("X"), &m_width, &m_height);
       m_width = 0;
     }
 
     /// This is the default.
     else
-      dc.GetTextExtent(m_text, &m_width, &m_height);
+      FontCache::GetTextExtent(dc, m_text, &m_width, &m_height);
 
     m_width = m_width + 2 * SCALE_PX(MC_TEXT_PADDING, scale);
     m_height = m_height + 2 * SCALE_PX(MC_TEXT_PADDING, scale);
@@ -173,14 +204,14 @@ void TextCell::Draw(CellParser& parser, wxPoint point, int fontsize, bool all)
     }
 
     /// Check if we are using jsMath and have jsMath character
-    else if (m_altJs && parser.CheckTeXFonts())
-      dc.DrawText(m_altJsText,
+    else if (m_altJsText != NULL && parser.CheckTeXFonts())
+      dc.DrawText(*m_altJsText,
                   point.x + SCALE_PX(MC_TEXT_PADDING, scale),
                   point.y - m_realCenter + SCALE_PX(MC_TEXT_PADDING, scale));
 
     /// We are using a special symbol
-    else if (m_alt)
-      dc.DrawText(m_altText,
+    else if (m_altText != NULL)
+      dc.DrawText(*m_altText,
                   point.x + SCALE_PX(MC_TEXT_PADDING, scale),
                   point.y - m_realCenter + SCALE_PX(MC_TEXT_PADDING, scale));
 
@@ -216,44 +247,44 @@ void TextCell::SetFont(CellParser& parser, int fontsize)
   fontsize1 = MAX(fontsize1, 1);
 
   // Use jsMath
-  if (m_altJs && parser.CheckTeXFonts())
+  if (m_altJsText != NULL && parser.CheckTeXFonts())
   {
-    dc.SetFont(wxFont(fontsize1, wxFONTFAMILY_MODERN,
-                      wxFONTSTYLE_NORMAL,
-                      parser.IsBold(m_textStyle),
-                      parser.IsUnderlined(m_textStyle),
-                      m_texFontname));
+    dc.SetFont(FontCache::Get(fontsize1, wxFONTFAMILY_MODERN,
+                              wxFONTSTYLE_NORMAL,
+                              parser.IsBold(m_textStyle),
+                              parser.IsUnderlined(m_textStyle),
+                              *m_texFontname));
   }
 
   // We have an alternative symbol
-  else if (m_alt)
-    dc.SetFont(wxFont(fontsize1, wxFONTFAMILY_MODERN,
-                      wxFONTSTYLE_NORMAL,
-                      parser.IsBold(m_textStyle),
-                      false,
-                      m_fontname != wxEmptyString ?
-                          m_fontname : parser.GetFontName(m_textStyle),
-                      parser.GetFontEncoding()));
+  else if (m_altText != NULL)
+    dc.SetFont(FontCache::Get(fontsize1, wxFONTFAMILY_MODERN,
+                              wxFONTSTYLE_NORMAL,
+                              parser.IsBold(m_textStyle),
+                              false,
+                              m_fontname != NULL ?
+                                  *m_fontname : parser.GetFontName(m_textStyle),
+                              parser.GetFontEncoding()));
 
   // Titles, sections, subsections - don't underline
   else if ((m_textStyle == TS_TITLE) ||
            (m_textStyle == TS_SECTION) ||
            (m_textStyle == TS_SUBSECTION))
-    dc.SetFont(wxFont(fontsize1, wxFONTFAMILY_MODERN,
-                      parser.IsItalic(m_textStyle),
-                      parser.IsBold(m_textStyle),
-                      false,
-                      parser.GetFontName(m_textStyle),
-                      parser.GetFontEncoding()));
+    dc.SetFont(FontCache::Get(fontsize1, wxFONTFAMILY_MODERN,
+                              parser.IsItalic(m_textStyle),
+                              parser.IsBold(m_textStyle),
+                              false,
+                              parser.GetFontName(m_textStyle),
+                              parser.GetFontEncoding()));
 
   // Default
   else
-    dc.SetFont(wxFont(fontsize1, wxFONTFAMILY_MODERN,
-                      parser.IsItalic(m_textStyle),
-                      parser.IsBold(m_textStyle),
-                      parser.IsUnderlined(m_textStyle),
-                      parser.GetFontName(m_textStyle),
-                      parser.GetFontEncoding()));
+    dc.SetFont(FontCache::Get(fontsize1, wxFONTFAMILY_MODERN,
+                              parser.IsItalic(m_textStyle),
+                              parser.IsBold(m_textStyle),
+                              parser.IsUnderlined(m_textStyle),
+                              parser.GetFontName(m_textStyle),
+                              parser.GetFontEncoding()));
 }
 
 bool TextCell::IsOperator()
@@ -384,54 +415,120 @@ bool TextCell::IsShortNum()
   return false;
 }
 
+/***
+ * Picks the replacement of the text from m_symbol, which was looked up when
+ * the text was set. Only the keepPercent setting is read here.
+ */
 void TextCell::SetAltText(CellParser& parser)
 {
-  m_altJs = m_alt = false;
-  if (m_textStyle == TS_DEFAULT)
+  m_altText = m_altJsText = NULL;
+  if (m_textStyle == TS_DEFAULT || m_symbol == NULL)
     return ;
 
   /// Greek characters are defined in jsMath, Windows and Unicode
   if (m_textStyle == TS_GREEK_CONSTANT)
   {
-    m_altJs = true;
-    m_altJsText = GetGreekStringTeX();
-    m_texFontname = wxT("jsMath-cmmi10");
-
-#if wxUSE_UNICODE
-    m_alt = true;
-    m_altText = GetGreekStringUnicode();
-#elif defined __WXMSW__
-    m_alt = true;
-    m_altText = GetGreekStringSymbol();
-    m_fontname = wxT("Symbol");
-#endif
+    m_altJsText = m_symbol->greekJs;
+    m_texFontname = m_symbol->greekJsFont;
+    m_altText = m_symbol->greek;
+    if (m_altText != NULL)
+      m_fontname = m_symbol->font;
   }
 
   /// Check for other symbols
   else {
-    m_altJsText = GetSymbolTeX();
-    if (m_altJsText != wxEmptyString)
-    {
-      if (m_text == wxT("+") || m_text == wxT("="))
-        m_texFontname = wxT("jsMath-cmr10");
-      else if (m_text == wxT("%pi"))
-        m_texFontname = wxT("jsMath-cmmi10");
-      else
-        m_texFontname = wxT("jsMath-cmsy10");
-      m_altJs = true;
-    }
+    m_altJsText = m_symbol->symbolJs;
+    if (m_altJsText != NULL)
+      m_texFontname = m_symbol->symbolJsFont;
+    m_altText = parser.CheckKeepPercent() ? m_symbol->symbolPercent :
+                                            m_symbol->symbol;
+    if (m_altText != NULL)
+      m_fontname = m_symbol->font;
+  }
+}
+
+const TextSymbol *TextCell::FindSymbol(const wxString& text)
+{
+#if wxUSE_THREADS
+  wxCriticalSectionLocker lock(symbolsLock);
+#endif
+
+  if (symbols == NULL)
+    BuildSymbols();
+
+  TextSymbols::iterator it = symbols->find(text);
+  if (it == symbols->end())
+    return NULL;
+  return &it->second;
+}
+
+/***
+ * Fills the symbol table with the results of the GetGreekString... and
+ * GetSymbol... functions for each text which they replace. Greek letters
+ * are known with and without %, and capitalized.
+ */
+void TextCell::BuildSymbols()
+{
+  static const wxChar *greek[] = {
+    wxT("alpha"), wxT("beta"), wxT("gamma"), wxT("delta"), wxT("epsilon"),
+    wxT("zeta"), wxT("eta"), wxT("theta"), wxT("iota"), wxT("kappa"),
+    wxT("lambda"), wxT("mu"), wxT("nu"), wxT("xi"), wxT("omicron"), wxT("pi"),
+    wxT("rho"), wxT("sigma"), wxT("tau"), wxT("upsilon"), wxT("phi"),
+    wxT("chi"), wxT("psi"), wxT("omega")
+  };
+  static const wxChar *other[] = {
+    wxT("+"), wxT("="), wxT("inf"), wxT("%pi"), wxT("<="), wxT(">="), wxT("->"),
+    wxT("not"), wxT(" and "), wxT(" or "), wxT(" xor "), wxT(" nand "),
+    wxT(" nor "), wxT(" implies "), wxT(" equiv "), wxT("%e"), wxT("%i")
+  };
+
+  wxArrayString texts;
+  for (size_t i = 0; i < sizeof(greek) / sizeof(greek[0]); i++)
+  {
+    wxString name(greek[i]);
+    wxString capital = name;
+    capital[0] = wxToupper(name[0]);
+    texts.Add(name);
+    texts.Add(wxT("%") + name);
+    texts.Add(capital);
+    texts.Add(wxT("%") + capital);
+  }
+  for (size_t i = 0; i < sizeof(other) / sizeof(other[0]); i++)
+    texts.Add(other[i]);
+
+  symbols = new TextSymbols;
+  TextCell cell;
+  for (size_t i = 0; i < texts.GetCount(); i++)
+  {
+    cell.m_text = texts[i];
+    TextSymbol symbol;
+
+    symbol.greekJs = StringPool::Intern(cell.GetGreekStringTeX());
+    symbol.greekJsFont = StringPool::Intern(wxT("jsMath-cmmi10"));
+    symbol.symbolJs = StringPool::Intern(cell.GetSymbolTeX());
+    if (cell.m_text == wxT("+") || cell.m_text == wxT("="))
+      symbol.symbolJsFont = StringPool::Intern(wxT("jsMath-cmr10"));
+    else if (cell.m_text == wxT("%pi"))
+      symbol.symbolJsFont = StringPool::Intern(wxT("jsMath-cmmi10"));
+    else
+      symbol.symbolJsFont = StringPool::Intern(wxT("jsMath-cmsy10"));
+
 #if wxUSE_UNICODE
-    m_altText = GetSymbolUnicode(parser.CheckKeepPercent());
-    if (m_altText != wxEmptyString)
-      m_alt = true;
+    symbol.greek = StringPool::Intern(cell.GetGreekStringUnicode());
+    symbol.symbol = StringPool::Intern(cell.GetSymbolUnicode(false));
+    symbol.symbolPercent = StringPool::Intern(cell.GetSymbolUnicode(true));
+    symbol.font = NULL;
 #elif defined __WXMSW__
-    m_altText = GetSymbolSymbol(parser.CheckKeepPercent());
-    if (m_altText != wxEmptyString)
-    {
-      m_alt = true;
-      m_fontname = wxT("Symbol");
-    }
+    symbol.greek = StringPool::Intern(cell.GetGreekStringSymbol());
+    symbol.symbol = StringPool::Intern(cell.GetSymbolSymbol(false));
+    symbol.symbolPercent = StringPool::Intern(cell.GetSymbolSymbol(true));
+    symbol.font = StringPool::Intern(wxT("Symbol"));
+#else
+    symbol.greek = symbol.symbol = symbol.symbolPercent = NULL;
+    symbol.font = NULL;
 #endif
+
+    (*symbols)[texts[i]] = symbol;
   }
 }
 
@@ -21,6 +21,9 @@
 #define _TEXTCELL_H_
 
 #include "MathCell.h"
+#include "StringPool.h"
+
+struct TextSymbol;
 
 class TextCell : public MathCell
 {
@@ -53,13 +56,15 @@ public:
   bool IsShortNum();
 protected:
   void SetAltText(CellParser& parser);
+  static const TextSymbol *FindSymbol(const wxString& text);
+  static void BuildSymbols();
   wxString m_text;
-  wxString m_altText, m_altJsText;
-  wxString m_fontname, m_texFontname;
-  bool m_alt, m_altJs;
+  const TextSymbol *m_symbol; // the glyphs which can replace m_text
+  // Interned in the StringPool, NULL if the cell has no alternative text
+  const wxString *m_altText, *m_altJsText;
+  const wxString *m_fontname, *m_texFontname;
   int m_realCenter;
   int m_fontSize;
-  int m_fontSizeTeX;
   int m_fontSizeLabel;
   int m_labelWidth, m_labelHeight;
 };
@@ -0,0 +1,120 @@
+///
+///  Copyright (C) 2013 The wxMaxima team
+///
+///  This program is free software; you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation; either version 2 of the License, or
+///  (at your option) any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program; if not, write to the Free Software
+///  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+///
+
+
+#include "TileCache.h"
+
+TileCache::TileCache()
+{
+  m_rendered = m_reused = 0;
+}
+
+TileCache::~TileCache()
+{
+  Clear();
+  for (size_t i = 0; i < m_spare.size(); i++)
+    delete m_spare[i];
+}
+
+wxBitmap *TileCache::Get(int x, int y)
+{
+  std::map<std::pair<int, int>, Tile>::iterator it =
+    m_tiles.find(std::make_pair(x, y));
+  if (it == m_tiles.end())
+    return NULL;
+
+  m_used.splice(m_used.begin(), m_used, it->second.use);
+  m_reused++;
+  return it->second.bitmap;
+}
+
+wxBitmap *TileCache::Add(int x, int y)
+{
+  std::pair<int, int> key(x, y);
+  std::map<std::pair<int, int>, Tile>::iterator it = m_tiles.find(key);
+  if (it != m_tiles.end())
+    Remove(it);
+
+  while (m_tiles.size() >= TILE_CACHE_SIZE)
+    Remove(m_tiles.find(m_used.back()));
+
+  Tile tile;
+  if (!m_spare.empty())
+  {
+    tile.bitmap = m_spare.back();
+    m_spare.pop_back();
+  }
+  else
+    tile.bitmap = new wxBitmap(TILE_WIDTH, TILE_HEIGHT);
+  m_used.push_front(key);
+  tile.use = m_used.begin();
+  m_tiles[key] = tile;
+  m_rendered++;
+  return tile.bitmap;
+}
+
+/***
+ * Drops a tile. Its bitmap is kept for a new tile.
+ */
+void TileCache::Remove(std::map<std::pair<int, int>, Tile>::iterator it)
+{
+  m_spare.push_back(it->second.bitmap);
+  m_used.erase(it->second.use);
+  m_tiles.erase(it);
+}
+
+/***
+ * Drops the tiles which show some part of rect (in document coordinates).
+ */
+void TileCache::Invalidate(const wxRect& rect)
+{
+  std::map<std::pair<int, int>, Tile>::iterator it = m_tiles.begin();
+  while (it != m_tiles.end())
+  {
+    wxRect tile(it->first.first * TILE_WIDTH, it->first.second * TILE_HEIGHT,
+                TILE_WIDTH, TILE_HEIGHT);
+    std::map<std::pair<int, int>, Tile>::iterator next = it;
+    ++next;
+    if (tile.Intersects(rect))
+      Remove(it);
+    it = next;
+  }
+}
+
+/***
+ * Drops the tiles which show some part of the document at or below y.
+ */
+void TileCache::InvalidateBelow(int y)
+{
+  std::map<std::pair<int, int>, Tile>::iterator it = m_tiles.begin();
+  while (it != m_tiles.end())
+  {
+    std::map<std::pair<int, int>, Tile>::iterator next = it;
+    ++next;
+    if ((it->first.second + 1) * TILE_HEIGHT > y)
+      Remove(it);
+    it = next;
+  }
+}
+
+void TileCache::Clear()
+{
+  while (!m_tiles.empty())
+    Remove(m_tiles.begin());
+}
@@ -0,0 +1,73 @@
+///
+///  Copyright (C) 2013 The wxMaxima team
+///
+///  This program is free software; you can redistribute it and/or modify
+///  it under the terms of the GNU General Public License as published by
+///  the Free Software Foundation; either version 2 of the License, or
+///  (at your option) any later version.
+///
+///  This program is distributed in the hope that it will be useful,
+///  but WITHOUT ANY WARRANTY; without even the implied warranty of
+///  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///  GNU General Public License for more details.
+///
+///
+///  You should have received a copy of the GNU General Public License
+///  along with this program; if not, write to the Free Software
+///  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+///
+
+
+#ifndef _TILECACHE_H_
+#define _TILECACHE_H_
+
+#include <wx/wx.h>
+
+#include <map>
+#include <list>
+#include <vector>
+
+#define TILE_WIDTH 512
+#define TILE_HEIGHT 256
+#define TILE_CACHE_SIZE 64   // about 32MB of tiles
+
+/***
+ * TileCache keeps rendered parts of the document, so that a paint only
+ * renders what was never drawn or has changed since. The document is
+ * divided in tiles of TILE_WIDTH x TILE_HEIGHT pixels; tile (x, y) shows the
+ * document from (x*TILE_WIDTH, y*TILE_HEIGHT).
+ *
+ * Tiles are keyed by document coordinates, so they stay valid while the
+ * window scrolls. Everything which changes how some part of the document
+ * looks has to invalidate the tiles of that part. The least recently used
+ * tiles are dropped when there are more than TILE_CACHE_SIZE. The bitmaps
+ * of dropped tiles are used again for new tiles.
+ */
+class TileCache
+{
+public:
+  TileCache();
+  ~TileCache();
+  // returns NULL if the tile has to be rendered
+  wxBitmap *Get(int x, int y);
+  // returns a bitmap for the tile, which the caller renders
+  wxBitmap *Add(int x, int y);
+  void Invalidate(const wxRect& rect);
+  void InvalidateBelow(int y);
+  void Clear();
+  long GetRendered() { return m_rendered; }
+  long GetReused() { return m_reused; }
+private:
+  struct Tile
+  {
+    wxBitmap *bitmap;
+    std::list< std::pair<int, int> >::iterator use;
+  };
+  void Remove(std::map<std::pair<int, int>, Tile>::iterator it);
+  std::map<std::pair<int, int>, Tile> m_tiles;
+  std::list< std::pair<int, int> > m_used; // most recently used first
+  std::vector<wxBitmap*> m_spare; // bitmaps of dropped tiles, for Add
+  long m_rendered, m_reused;
+};
+
+#endif // _TILECACHE_H_
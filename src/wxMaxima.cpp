@@ -40,6 +40,7 @@
 #include "MyTipProvider.h"
 #include "EditorCell.h"
 #include "SlideShowCell.h"
+#include "SpoolCell.h"
 #include "PlotFormatWiz.h"
 
 #include <wx/clipbrd.h>
@@ -52,6 +53,8 @@
 #include <wx/dynlib.h>
 #include <wx/dir.h>
 #include <wx/filename.h>
+#include <wx/file.h>
+#include <wx/stopwatch.h>
 #include <wx/artprov.h>
 #include <wx/aboutdlg.h>
 #include <wx/utils.h>
@@ -86,19 +89,40 @@ wxMaxima::wxMaxima(wxWindow *parent, int id, const wxString title,
   m_port = 4010;
   m_pid = -1;
   m_inLispMode = false;
-  m_first = true;
   m_isRunning = false;
   m_promptSuffix = wxT("<PROMPT-S/>");
   m_promptPrefix = wxT("<PROMPT-P/>");
 
   m_firstPrompt = wxT("(%i1) ");
 
+  m_maximaStream.SetPromptMarkers(m_promptPrefix, m_promptSuffix);
+  m_maximaStream.SetFirstPrompt(m_firstPrompt);
+
   m_client = NULL;
   m_server = NULL;
+#if WXM_READER_THREAD
+  m_reader = NULL;
+#endif
+#if WXM_PARSER_THREADS
+  m_parserPool = NULL;
+#endif
+  m_socketReadSize = SOCKET_SIZE;
 
   wxConfig::Get()->Read(wxT("lastPath"), &m_lastPath);
   m_lastPrompt = wxEmptyString;
 
+  m_pipelineDepth = 1;
+  m_pipelineUnsupported = false;
+  ResetPipeline();
+
+  m_outputCells = 0;
+  m_floodWindowBytes = 0;
+  m_floodWindowStart = 0;
+  m_floodSeconds = 0;
+  m_flooding = false;
+  m_floodFailed = false;
+  m_spooledLines = m_spooledBytes = 0;
+
 #if WXM_PRINT
   CheckForPrintingSupport();
   m_printData = new wxPrintData;
@@ -132,20 +156,25 @@ wxMaxima::wxMaxima(wxWindow *parent, int id, const wxString title,
 #endif
 
   GetMenuBar()->Enable(menu_interrupt_id, false);
-
-  /// RegEx for function definitions
-  m_funRegEx.Compile(wxT("^ *([[:alnum:]%_]+) *\\(([[:alnum:]%_,[[.].] ]*)\\) *:="));
-  // RegEx for variable definitions
-  m_varRegEx.Compile(wxT("^ *([[:alnum:]%_]+) *:"));
-  // RegEx for blank statement removal
-  m_blankStatementRegEx.Compile(wxT("(^;)|((^|;)(((\\/\\*.*\\*\\/)?([[:space:]]*))+;)+)"));
 }
 
 wxMaxima::~wxMaxima()
 {
+#if WXM_READER_THREAD
+  StopReader();
+#endif
+#if WXM_PARSER_THREADS
+  StopParserPool(false);
+#endif
   if (m_client != NULL)
     m_client->Destroy();
 
+  if (m_floodFile.IsOpened())
+    m_floodFile.Close();
+  for (unsigned int i = 0; i < m_spoolFiles.GetCount(); i++)
+    if (wxFileExists(m_spoolFiles[i]))
+      wxRemoveFile(m_spoolFiles[i]);
+
 #if WXM_PRINT
   delete m_printData;
 #endif
@@ -388,10 +417,23 @@ void wxMaxima::DoConsoleAppend(wxString s, int type, bool newLine,
 {
   MathCell* cell;
 
+  m_outputCells++;
   s.Replace(wxT("\n"), wxT(""), true);
 
+#if WXM_PARSER_THREADS
+  if (ParseInPool(s, type, newLine, bigSkip))
+    return ;
+#endif
+
+  FlushParses();
+
   cell = m_MParser.ParseLine(s, type);
 
+  InsertParsedLine(cell, newLine, bigSkip);
+}
+
+void wxMaxima::InsertParsedLine(MathCell *cell, bool newLine, bool bigSkip)
+{
   if (cell == NULL)
   {
     wxMessageBox(_("There was an error in generated XML!\n\n"
@@ -404,13 +446,106 @@ void wxMaxima::DoConsoleAppend(wxString s, int type, bool newLine,
   m_console->InsertLine(cell, newLine || cell->BreakLineHere());
 }
 
+/***
+ * Inserts all outputs which are still parsed in m_parserPool. Has to be
+ * called before anything else is added to the document or the evaluation
+ * goes on, so that the order of the output is kept.
+ */
+void wxMaxima::FlushParses()
+{
+#if WXM_PARSER_THREADS
+  if (m_parserPool == NULL)
+    return ;
+
+  ParseJob *job;
+  while ((job = m_parserPool->GetResult(true)) != NULL)
+  {
+    InsertParsedLine(job->cell, job->newLine, job->bigSkip);
+    delete job;
+  }
+#endif
+}
+
+#if WXM_PARSER_THREADS
+/***
+ * Hands s to the parser pool if parallel parsing is enabled. Outputs with
+ * images are parsed in the GUI thread since the parser loads the images.
+ */
+bool wxMaxima::ParseInPool(wxString s, int type, bool newLine, bool bigSkip)
+{
+  bool parallelParsing = false, showLong = false, shareSubtrees = false;
+  wxConfig::Get()->Read(wxT("parallelParsing"), &parallelParsing);
+  wxConfig::Get()->Read(wxT("showLong"), &showLong);
+  wxConfig::Get()->Read(wxT("shareSubtrees"), &shareSubtrees);
+
+  if (!parallelParsing)
+  {
+    StopParserPool();
+    return false;
+  }
+
+  if (type != MC_TYPE_DEFAULT ||
+      s.Find(wxT("<img")) > -1 || s.Find(wxT("<slide")) > -1)
+    return false;
+
+  // Long outputs are only split up (or replaced) unless they are shown in full
+  if (!showLong && s.Length() >= MAXLENGTH)
+    return false;
+
+  if (m_parserPool == NULL)
+  {
+    m_parserPool = new ParserPool(this);
+    if (!m_parserPool->Start())
+    {
+      delete m_parserPool;
+      m_parserPool = NULL;
+      return false;
+    }
+  }
+
+  m_parserPool->Add(s, type, newLine, bigSkip, showLong, shareSubtrees);
+  return true;
+}
+
+/***
+ * Inserts the finished outputs, up to the first one which is not finished.
+ */
+void wxMaxima::OnParserEvent(wxCommandEvent& event)
+{
+  if (m_parserPool == NULL)
+    return ;
+
+  ParseJob *job;
+  while ((job = m_parserPool->GetResult(false)) != NULL)
+  {
+    InsertParsedLine(job->cell, job->newLine, job->bigSkip);
+    delete job;
+  }
+}
+
+void wxMaxima::StopParserPool(bool flush)
+{
+  if (m_parserPool == NULL)
+    return ;
+
+  if (flush)
+    FlushParses();
+
+  delete m_parserPool;
+  m_parserPool = NULL;
+}
+#endif
+
 void wxMaxima::DoRawConsoleAppend(wxString s, int type)
 {
+  FlushParses();
+
   if (type == MC_TYPE_MAIN_PROMPT)
   {
     TextCell* cell = new TextCell(s);
     cell->SetType(type);
     m_console->InsertLine(cell, true);
+    m_outputCells++;
   }
 
   else
@@ -438,27 +573,10 @@ void wxMaxima::DoRawConsoleAppend(wxString s, int type)
       count++;
     }
     m_console->InsertLine(tmp, true);
+    m_outputCells += count;
   }
 }
 
-/**
- * We need to remove any statement which would be considered empty
- * and thus cause an error. Comments within non-empty expressions seem to
- * be fine.
- *
- * What we need to remove is any statements which are any amount of whitespace
- * and any amount of comments, in any order, ended by a semicolon,
- * and nothing else.
- *
- * The most that should be left over is a single empty statement, ";".
- *
- * @param s The command string from which to remove comment expressions.
- */
-void wxMaxima::StripComments(wxString& s)
-{
-  m_blankStatementRegEx.Replace(&s, wxT(";"));
-}
-
 void wxMaxima::SendMaxima(wxString s, bool history)
 {
   if (!m_variablesOK) {
@@ -466,6 +584,64 @@ void wxMaxima::SendMaxima(wxString s, bool history)
     SetupVariables();
   }
 
+  SetStatusText(_("Maxima is calculating"), 1);
+  m_dispReadOut = false;
+
+  m_inputPreprocessor.Process(s, history);
+
+  /// Add this command to history
+  if (history)
+    AddToHistory(m_inputPreprocessor.GetHistory());
+
+  /// Function/variable definitions
+  const wxArrayString& symbols = m_inputPreprocessor.GetSymbols();
+  for (unsigned int i = 0; i < symbols.GetCount(); i++)
+    m_console->AddSymbol(symbols[i]);
+  const wxArrayString& templates = m_inputPreprocessor.GetTemplates();
+  for (unsigned int i = 0; i < templates.GetCount(); i++)
+    m_console->AddSymbol(templates[i], true);
+
+  m_console->EnableEdit(false);
+
+  std::string bytes = MaximaStream::ToBytes(m_inputPreprocessor.GetOutput());
+
+#if WXM_READER_THREAD
+  if (m_reader != NULL)
+  {
+    m_reader->Write(bytes.data(), bytes.length());
+    return;
+  }
+#endif
+
+  m_client->Write(bytes.data(), bytes.length());
+}
+
+/***
+ * Compares the time SendMaxima needs to prepare a large input with the
+ * time the replace/regex passes used before InputPreprocessor needed.
+ * Nothing is sent to maxima.
+ */
+void wxMaxima::BenchmarkInput()
+{
+  wxString input = wxT("f(x, [l]) := x^2 + length(l);\n/* data */\ndata: [");
+  for (int i = 0; i < 50000; i++)
+  {
+    if (i > 0)
+      input << wxT(", ");
+    input << i;
+  }
+  input << wxT("];\n;\nprint(\"done; really\");\n");
+
+  // The regular expressions of the old passes
+  wxRegEx funRegEx(wxT("^ *([[:alnum:]%_]+) *\\(([[:alnum:]%_,[[.].] ]*)\\) *:="));
+  wxRegEx varRegEx(wxT("^ *([[:alnum:]%_]+) *:"));
+  wxRegEx blankStatementRegEx(wxT("(^;)|((^|;)(((\\/\\*.*\\*\\/)?([[:space:]]*))+;)+)"));
+
+  wxStopWatch sw;
+  std::string bytes;
+
+  // The old passes
+  wxString s = input;
 #if wxUSE_UNICODE
   s.Replace(wxT("\x00B2"), wxT("^2"));
   s.Replace(wxT("\x00B3"), wxT("^3"));
@@ -485,61 +661,153 @@ void wxMaxima::SendMaxima(wxString s, bool history)
   s.Replace(wxT("\x00AC"), wxT(" not "));
   s.Replace(wxT("\x2212"), wxT("-"));
 #endif
-
-  SetStatusText(_("Maxima is calculating"), 1);
-  m_dispReadOut = false;
-
-  /// Add this command to history
-  if (history)
-    AddToHistory(s);
-
   s.Replace(wxT("\n"), wxT(" "));
   s.Append(wxT("\n"));
-  StripComments(s);
-
-  /// Check for function/variable definitions
+  blankStatementRegEx.Replace(&s, wxT(";"));
+  int definitions = 0;
   wxStringTokenizer commands(s, wxT(";$"));
   while (commands.HasMoreTokens())
   {
     wxString line = commands.GetNextToken();
-    if (m_varRegEx.Matches(line))
-      m_console->AddSymbol(m_varRegEx.GetMatch(line, 1));
+    if (varRegEx.Matches(line))
+      definitions++;
+    if (funRegEx.Matches(line))
+      definitions++;
+  }
+#if wxUSE_UNICODE
+  bytes = std::string(s.utf8_str(), strlen(s.utf8_str()));
+#else
+  bytes = std::string(s.c_str(), s.Length());
+#endif
+  long oldTime = sw.Time();
+
+  // InputPreprocessor
+  sw.Start();
+  InputPreprocessor preprocessor;
+  preprocessor.Process(input, true);
+  bytes = MaximaStream::ToBytes(preprocessor.GetOutput());
+  long newTime = sw.Time();
+
+  wxMessageBox(wxString::Format(_("Input size: %lu characters\n"
+                                  "Replace and regex passes: %ld ms (%d definitions)\n"
+                                  "Single pass: %ld ms (%lu definitions)"),
+                                (unsigned long)input.Length(),
+                                oldTime, definitions, newTime,
+                                (unsigned long)(preprocessor.GetSymbols().GetCount() +
+                                                preprocessor.GetTemplates().GetCount())),
+               _("Input benchmark"));
+}
+
+/***
+ * Builds, measures, draws, copies and deletes a row of a million cells.
+ * The list operations must neither recurse nor walk the list per cell.
+ */
+void wxMaxima::BenchmarkCells()
+{
+  const long count = 1000000;
+  wxStopWatch sw;
+
+  CellList row;
+  for (long i = 0; i < count; i++)
+    row.Append(new TextCell(i % 2 ? wxT("+") : wxT("x")));
+  MathCell *first = row.GetFirst();
+  long buildTime = sw.Time();
+
+  wxBitmap bitmap(400, 100);
+  wxMemoryDC dc;
+  dc.SelectObject(bitmap);
+  CellParser parser(dc);
+  int fontsize = parser.GetMathFontSize();
+
+  sw.Start();
+  first->RecalculateWidths(parser, fontsize, true);
+  first->RecalculateSize(parser, fontsize, true);
+  int width = first->GetLineWidth(parser.GetScale());
+  int height = first->GetMaxHeight();
+  long measureTime = sw.Time();
+
+  sw.Start();
+  first->Draw(parser, wxPoint(0, first->GetMaxCenter()), fontsize, true);
+  long drawTime = sw.Time();
+  dc.SelectObject(wxNullBitmap);
+
+  sw.Start();
+  size_t length = first->ToString(true).Length();
+  long stringTime = sw.Time();
+
+  sw.Start();
+  MathCell *copy = first->Copy(true);
+  delete copy;
+  delete first;
+  long copyTime = sw.Time();
+
+  wxMessageBox(wxString::Format(_("Cells: %ld (%d x %d pixels, %lu characters)\n"
+                                  "Build: %ld ms\n"
+                                  "Measure: %ld ms\n"
+                                  "Draw: %ld ms\n"
+                                  "ToString: %ld ms\n"
+                                  "Copy and delete: %ld ms"),
+                                count, width, height, (unsigned long)length,
+                                buildTime, measureTime, drawTime, stringTime,
+                                copyTime),
+               _("Cell list benchmark"));
+}
 
-    if (m_funRegEx.Matches(line))
+/***
+ * Parses a long reply with a text before and between two <mth> blocks in
+ * parts (as with lazyLong) and shows all the parts. The result has to be
+ * the same as when the reply is parsed at once.
+ */
+void wxMaxima::TestLazyOutput()
+{
+  wxString reply = wxT("<span>Is  x  positive, negative or zero?<mth>");
+  for (long i = 0; i < MAXLENGTH / 10; i++)
+    reply += wxT("<n>") + wxString::Format(wxT("%ld"), i) + wxT("</n><t>+</t>");
+  reply += wxT("<n>0</n></mth>between the blocks<mth><v>x</v></mth></span>");
+
+  MathParser parser;
+  MathCell *full = parser.ParseLine(reply, MC_TYPE_DEFAULT, true);
+  MathCell *lazy = parser.ParseLine(reply, MC_TYPE_DEFAULT, false, true);
+
+  wxString fullText, lazyText;
+  long errors = 0, chunks = 1;
+  for (MathCell *tmp = full; tmp != NULL; tmp = tmp->m_next)
+    fullText += tmp->ToString(false);
+  for (MathCell *tmp = lazy; tmp != NULL; tmp = tmp->m_next)
+  {
+    MoreCell *more = dynamic_cast<MoreCell*>(tmp);
+    while (more != NULL && !more->IsDone())
     {
-      wxString funName = m_funRegEx.GetMatch(line, 1);
-      m_console->AddSymbol(funName);
-
-      /// Create a template from the input
-      wxString args = m_funRegEx.GetMatch(line, 2);
-      wxStringTokenizer argTokens(args, wxT(","));
-      funName << wxT("(");
-      int count = 0;
-      while (argTokens.HasMoreTokens()) {
-        if (count > 0)
-          funName << wxT(",");
-        wxString a = argTokens.GetNextToken().Trim().Trim(false);
-        if (a != wxEmptyString)
-        {
-          if (a[0]=='[')
-            funName << wxT("[<") << a.SubString(1, a.Length()-2) << wxT(">]");
-          else
-            funName << wxT("<") << a << wxT(">");
-          count++;
-        }
+      MathCell *chunk = more->ParseNext();
+      for (MathCell *cell = chunk; cell != NULL; cell = cell->m_next)
+      {
+        if (cell->GetType() == MC_TYPE_ERROR)
+          errors++;
+        lazyText += cell->ToString(false);
       }
-      funName << wxT(")");
-      m_console->AddSymbol(funName, true);
-    }
+      delete chunk;
+      chunks++;
+    }
+    if (more != NULL)
+      continue;
+    if (tmp->GetType() == MC_TYPE_ERROR)
+      errors++;
+    lazyText += tmp->ToString(false);
   }
 
-  m_console->EnableEdit(false);
-
-#if wxUSE_UNICODE
-  m_client->Write(s.utf8_str(), strlen(s.utf8_str()));
-#else
-  m_client->Write(s.c_str(), s.Length());
-#endif
+  bool passed = full != NULL && errors == 0 && lazyText == fullText;
+  delete full;
+  delete lazy;
+
+  wxMessageBox(wxString::Format(_("%s\n\n"
+                                  "Chunks: %ld\n"
+                                  "Errors: %ld\n"
+                                  "Characters: %lu shown in parts, %lu at once"),
+                                passed ? _("Passed") : _("Failed"),
+                                chunks, errors,
+                                (unsigned long)lazyText.Length(),
+                                (unsigned long)fullText.Length()),
+               _("Long output test"));
 }
 
 ///--------------------------------------------------------------------------------
@@ -547,17 +815,44 @@ void wxMaxima::SendMaxima(wxString s, bool history)
 ///--------------------------------------------------------------------------------
 
 /***
- * Convert problematic characters in buffer into something sane,
- * so that special character codes are not encountered unexpectedly
- * (i.e. early).
+ * Reads everything that is available on the socket into m_maximaStream.
+ * The size of single reads grows while maxima sends large outputs and falls
+ * back when the output is small again. Returns the number of bytes read.
  */
-void wxMaxima::SanitizeSocketBuffer(char *buffer, int length)
+size_t wxMaxima::ReadSocket()
 {
-  for (int i = 0; i < length; i++)
+  size_t total = 0;
+  bool newline = false;
+
+  do
   {
-    if (buffer[i] == 0)
-      buffer[i] = ' ';  // convert input null (0) to space (0x20)
+    char *buffer = m_maximaStream.GetWriteBuffer(m_socketReadSize);
+    m_client->Read(buffer, m_socketReadSize);
+    if (m_client->Error())
+      break;
+
+    size_t read = m_client->LastCount();
+    if (read == 0)
+      break;
+
+    m_maximaStream.Commit(read);
+    if (total == 0)
+      newline = (read == 1 && buffer[0] == '\n');
+    total += read;
+
+    if (read == m_socketReadSize && m_socketReadSize < SOCKET_SIZE_MAX)
+      m_socketReadSize *= 2;
+  } while (m_client->IsData());
+
+  if (total < m_socketReadSize / 4 && m_socketReadSize > SOCKET_SIZE)
+    m_socketReadSize /= 2;
+
+  if (!m_dispReadOut && total > 0 && !(total == 1 && newline)) {
+    SetStatusText(_("Reading Maxima output"), 1);
+    m_dispReadOut = true;
   }
+
+  return total;
 }
 
 /***
@@ -566,62 +861,100 @@ void wxMaxima::SanitizeSocketBuffer(char *buffer, int length)
  */
 void wxMaxima::ClientEvent(wxSocketEvent& event)
 {
-  char buffer[SOCKET_SIZE + 1];
-  int read;
+#if WXM_READER_THREAD
+  // The reader thread owns the socket
+  if (m_reader != NULL)
+    return;
+#endif
+
   switch (event.GetSocketEvent())
   {
 
   case wxSOCKET_INPUT:
-    m_client->Read(buffer, SOCKET_SIZE);
-    if (!m_client->Error())
-    {
-      read = m_client->LastCount();
-      buffer[read] = 0;
+    if (ReadSocket() > 0)
+      ReadMaximaStream();
+    m_maximaStream.Shrink();
+    break;
+
+  case wxSOCKET_LOST:
+    SocketLost();
+    break;
 
-      SanitizeSocketBuffer(buffer, read);
+  default:
+    break;
+  }
+}
 
-#if wxUSE_UNICODE
-      m_currentOutput += wxString(buffer, wxConvUTF8);
-#else
-      m_currentOutput += wxString(buffer, *wxConvCurrent);
+void wxMaxima::SocketLost()
+{
+#if WXM_READER_THREAD
+  StopReader();
 #endif
+  EndFlood();
+  if (!m_closing)
+    ConsoleAppend(wxT("\nCLIENT: Lost socket connection ...\n"
+                      "Restart Maxima with 'Maxima->Restart Maxima'.\n"),
+                  MC_TYPE_ERROR);
+  m_console->SetWorkingGroup(NULL);
+  m_console->SetSelection(NULL);
+  m_console->SetActiveCell(NULL);
+  ResetPipeline();
+  m_pid = -1;
+  m_client->Destroy();
+  m_client = NULL;
+  m_isConnected = false;
+}
 
-      if (!m_dispReadOut && m_currentOutput != wxT("\n")) {
-        SetStatusText(_("Reading Maxima output"), 1);
-        m_dispReadOut = true;
-      }
+#if WXM_READER_THREAD
+/***
+ * The reader thread has new frames. The evaluation queue and the document
+ * are only touched here, in the GUI thread.
+ */
+void wxMaxima::OnReaderEvent(wxCommandEvent& event)
+{
+  if (m_reader == NULL)
+    return;
 
-      if (m_first && m_currentOutput.Find(m_firstPrompt) > -1)
-        ReadFirstPrompt();
+  m_reader->FramesRead();
 
-      ReadLoadSymbols();
+  MaximaFrame *frame;
+  while (m_reader != NULL && (frame = m_reader->GetFrame()) != NULL)
+  {
+    if (frame->type == MR_SOCKET_LOST)
+    {
+      delete frame;
+      SocketLost();
+      break;
+    }
 
-      ReadMath();
+    if (!m_dispReadOut && frame->data != "\n") {
+      SetStatusText(_("Reading Maxima output"), 1);
+      m_dispReadOut = true;
+    }
 
-      ReadPrompt();
+    ReadFrame(frame->type, MaximaStream::ToString(frame->data));
+    delete frame;
+  }
+}
 
-      ReadLispError();
-    }
-    break;
+/***
+ * Stops the reader thread, frames which were not handled yet are dropped.
+ */
+void wxMaxima::StopReader()
+{
+  if (m_reader == NULL)
+    return;
 
-  case wxSOCKET_LOST:
-    if (!m_closing)
-      ConsoleAppend(wxT("\nCLIENT: Lost socket connection ...\n"
-                        "Restart Maxima with 'Maxima->Restart Maxima'.\n"),
-                    MC_TYPE_ERROR);
-    m_console->SetWorkingGroup(NULL);
-    m_console->SetSelection(NULL);
-    m_console->SetActiveCell(NULL);
-    m_pid = -1;
-    m_client->Destroy();
-    m_client = NULL;
-    m_isConnected = false;
-    break;
+  m_reader->Stop();
 
-  default:
-    break;
-  }
+  MaximaFrame *frame;
+  while ((frame = m_reader->GetFrame()) != NULL)
+    delete frame;
+
+  delete m_reader;
+  m_reader = NULL;
 }
+#endif
 
 /***
  * ServerEvent is triggered when maxima connects to the socket server.
@@ -643,6 +976,22 @@ void wxMaxima::ServerEvent(wxSocketEvent& event)
       m_client->SetEventHandler(*this, socket_client_id);
       m_client->SetNotify(wxSOCKET_INPUT_FLAG | wxSOCKET_LOST_FLAG);
       m_client->Notify(true);
+#if WXM_READER_THREAD
+      bool readerThread = false;
+      wxConfig::Get()->Read(wxT("readerThread"), &readerThread);
+      if (readerThread)
+      {
+        StopReader();
+        m_reader = new MaximaReader(this, m_client, &m_maximaStream);
+        if (!m_reader->Start())
+        {
+          delete m_reader;
+          m_reader = NULL;
+          m_client->SetFlags(wxSOCKET_NONE);
+          m_client->Notify(true);
+        }
+      }
+#endif
 #ifndef __WXMSW__
       ReadProcessOutput();
 #endif
@@ -762,7 +1111,10 @@ bool wxMaxima::StartMaxima()
 
     m_process = new wxProcess(this, maxima_process_id);
     m_process->Redirect();
-    m_first = true;
+    m_maximaStream.Clear();
+    m_maximaStream.WaitForFirstPrompt();
+    ResetPipeline();
+    m_pipelineUnsupported = false;
     m_pid = -1;
     SetStatusText(_("Starting Maxima..."), 1);
     wxExecute(command, wxEXEC_ASYNC, m_process);
@@ -782,6 +1134,15 @@ void wxMaxima::Interrupt(wxCommandEvent& event)
     GetMenuBar()->Enable(menu_interrupt_id, false);
     return ;
   }
+
+  // The inputs which were sent ahead are dropped by maxima and sent again
+  // by ReadSkipped
+  if (m_pipelineActive)
+  {
+    wxFile cancel;
+    cancel.Create(m_pipelineCancelFile, true);
+  }
+
 #if defined (__WXMSW__)
   wxString path, maxima = GetCommand(false);
   wxArrayString out;
@@ -823,6 +1184,12 @@ void wxMaxima::OnProcessEvent(wxProcessEvent& event)
 
 void wxMaxima::CleanUp()
 {
+#if WXM_READER_THREAD
+  StopReader();
+#endif
+#if WXM_PARSER_THREADS
+  StopParserPool(false);
+#endif
   if (m_client)
     m_client->Notify(false);
   if (m_isConnected)
@@ -835,32 +1202,76 @@ void wxMaxima::CleanUp()
 ///  Dealing with stuff read from the socket
 ///--------------------------------------------------------------------------------
 
-void wxMaxima::ReadFirstPrompt()
+/***
+ * Hands the complete frames collected in m_maximaStream to the Read*
+ * functions. Incomplete output stays in the stream until more is read.
+ */
+void wxMaxima::ReadMaximaStream()
+{
+  int type;
+  wxString data;
+
+  while (m_maximaStream.NextFrame(&type, &data))
+    ReadFrame(type, data);
+}
+
+void wxMaxima::ReadFrame(int type, wxString data)
+{
+  // Only math can be parsed while earlier output is still parsed
+  if (type != MS_FRAME_MATH)
+    FlushParses();
+
+  // A prompt or an error ends the evaluation which flooded us
+  if (type != MS_FRAME_MATH && type != MS_FRAME_SYMBOLS)
+    EndFlood();
+
+  switch (type)
+  {
+  case MS_FRAME_FIRST_PROMPT:
+    ReadFirstPrompt(data);
+    break;
+  case MS_FRAME_SYMBOLS:
+    ReadLoadSymbols(data);
+    break;
+  case MS_FRAME_MATH:
+    ReadMath(data);
+    break;
+  case MS_FRAME_PROMPT:
+    ReadPrompt(data);
+    break;
+  case MS_FRAME_LISP_ERROR:
+    ReadLispError(data);
+    break;
+  case MS_FRAME_SKIPPED:
+    ReadSkipped();
+    break;
+  }
+}
+
+void wxMaxima::ReadFirstPrompt(wxString data)
 {
 #if defined(__WXMSW__)
-  int start = m_currentOutput.Find(wxT("Maxima"));
+  int start = data.Find(wxT("Maxima"));
   if (start == -1)
     start = 0;
   FirstOutput(wxT("wxMaxima ")
               wxT(VERSION)
               wxT(" http://andrejv.github.io/wxmaxima/\n") +
-              m_currentOutput.SubString(start, m_currentOutput.Length() - 1));
+              data.SubString(start, data.Length() - 1));
 #endif // __WXMSW__
 
-  int s = m_currentOutput.Find(wxT("pid=")) + 4;
-  int t = s + m_currentOutput.SubString(s, m_currentOutput.Length()).Find(wxT("\n")) - 1;
+  int s = data.Find(wxT("pid=")) + 4;
+  int t = s + data.SubString(s, data.Length()).Find(wxT("\n")) - 1;
 
   if (s < t)
-    m_currentOutput.SubString(s, t).ToLong(&m_pid);
+    data.SubString(s, t).ToLong(&m_pid);
 
   if (m_pid > 0)
     GetMenuBar()->Enable(menu_interrupt_id, true);
 
-  m_first = false;
   m_inLispMode = false;
   SetStatusText(_("Ready for user input"), 1);
   m_closing = false; // when restarting maxima this is temporarily true
-  m_currentOutput = wxEmptyString;
   m_console->EnableEdit(true);
 
   if (m_openFile.Length())
@@ -878,123 +1289,242 @@ void wxMaxima::ReadFirstPrompt()
 }
 
 /***
- * Checks if maxima displayed a new chunk of math
+ * Maxima displayed a new chunk of math (or the output before a prompt)
  */
-void wxMaxima::ReadMath()
+void wxMaxima::ReadMath(wxString o)
 {
-  int end = m_currentOutput.Find(m_promptPrefix);
-
-  while (end > -1)
-  {
-    m_readingPrompt = true;
-    wxString o = m_currentOutput.Left(end);
-    ConsoleAppend(o, MC_TYPE_DEFAULT);
-    m_currentOutput = m_currentOutput.SubString(end + m_promptPrefix.Length(),
-                      m_currentOutput.Length());
-    end = m_currentOutput.Find(m_promptPrefix);
-  }
-
-  if (m_readingPrompt)
+  if (SpoolOutput(o))
     return ;
+  ConsoleAppend(o, MC_TYPE_DEFAULT);
+}
 
-  wxString mth = wxT("</mth>");
-  end = m_currentOutput.Find(mth);
-  while (end > -1)
+/***
+ * The output as plain text, without the xml tags.
+ */
+static wxString OutputToText(const wxString& xml)
+{
+  wxString text;
+  text.Alloc(xml.Length());
+  size_t i = 0, length = xml.Length();
+
+  while (i < length)
   {
-    wxString o = m_currentOutput.Left(end);
-    ConsoleAppend(o + mth, MC_TYPE_DEFAULT);
-    m_currentOutput = m_currentOutput.SubString(end + mth.Length(),
-                      m_currentOutput.Length());
-    end = m_currentOutput.Find(mth);
+    if (xml[i] != wxT('<'))
+    {
+      text += xml[i++];
+      continue;
+    }
+    size_t end = xml.find(wxT('>'), i);
+    if (end == wxString::npos)
+      break;
+    if (xml.Mid(i, end - i + 1) == wxT("</mth>"))
+      text += wxT('\n');
+    i = end + 1;
   }
+
+  text.Replace(wxT("&lt;"), wxT("<"));
+  text.Replace(wxT("&gt;"), wxT(">"));
+  text.Replace(wxT("&quot;"), wxT("\""));
+  text.Replace(wxT("&apos;"), wxT("'"));
+  text.Replace(wxT("&amp;"), wxT("&"));
+  return text;
 }
 
-void wxMaxima::ReadLoadSymbols()
+/***
+ * Flood control: once the current evaluation added more cells than
+ * allowed, or maxima sent output faster than allowed for FLOOD_SECONDS
+ * seconds in a row, the output up to the next prompt is written to a
+ * temporary file instead of the document. A single large result is read
+ * at once, so it only counts in one second and is displayed as usual.
+ * Maxima's output is still read as fast as it arrives, so maxima is never
+ * blocked. Returns true if o was written to the file.
+ */
+bool wxMaxima::SpoolOutput(wxString o)
 {
-  int start = m_currentOutput.Find(wxT("<wxxml-symbols>"));
-  while (start > -1)
+  if (!m_flooding)
   {
-    int end = m_currentOutput.Find(wxT("</wxxml-symbols>"));
-    if (end > -1)
+    if (m_floodFailed)
+      return false;
+
+    bool floodControl = true;
+    int maxCells = 10000, maxRate = 2048;
+    wxConfig::Get()->Read(wxT("floodControl"), &floodControl);
+    if (!floodControl)
+      return false;
+    wxConfig::Get()->Read(wxT("floodCells"), &maxCells);
+    wxConfig::Get()->Read(wxT("floodRate"), &maxRate);
+
+    // The rate of a window is known when it is over, so the current output
+    // never counts against the limit
+    wxLongLong now = wxGetLocalTimeMillis();
+    long elapsed = (now - m_floodWindowStart).ToLong();
+    if (elapsed >= 1000)
     {
-      wxString symbols = m_currentOutput.SubString(start + 15, end - 1);
-      m_currentOutput = m_currentOutput.SubString(0, start-1) +
-                        m_currentOutput.SubString(end + 16, m_currentOutput.Length());
+      if (m_floodWindowBytes / elapsed * 1000 > 1024 * (long)maxRate)
+        m_floodSeconds++;
+      else
+        m_floodSeconds = 0;
+      m_floodWindowStart = now;
+      m_floodWindowBytes = 0;
+    }
+    m_floodWindowBytes += o.Length();
 
-      wxStringTokenizer templates(symbols, wxT("$"));
-      while (templates.HasMoreTokens())
-        m_console->AddSymbol(templates.GetNextToken());
+    if (m_outputCells < maxCells && m_floodSeconds < FLOOD_SECONDS)
+      return false;
 
-      start = m_currentOutput.Find(wxT("<wxxml-symbols>"));
+    // If the file can't be written, the output is shown until the prompt
+    m_floodFileName = wxFileName::CreateTempFileName(wxT("wxmaxima"));
+    if (m_floodFileName.IsEmpty())
+    {
+      m_floodFailed = true;
+      return false;
     }
-    else
-      start = -1;
+    // The extension lets the system choose a program to open it
+    if (wxRenameFile(m_floodFileName, m_floodFileName + wxT(".txt")))
+      m_floodFileName += wxT(".txt");
+    if (!m_floodFile.Open(m_floodFileName, wxFile::write))
+    {
+      wxRemoveFile(m_floodFileName);
+      m_floodFailed = true;
+      return false;
+    }
+    m_spoolFiles.Add(m_floodFileName);
+
+    FlushParses();
+    m_flooding = true;
+    m_spooledLines = m_spooledBytes = 0;
   }
+
+  wxString text = OutputToText(o);
+  m_floodFile.Write(text, wxConvUTF8);
+  m_spooledBytes += o.Length();
+  m_spooledLines += text.Freq(wxT('\n'));
+
+  SetStatusText(wxString::Format(_("Too much output, %ld lines written to a file"),
+                                 m_spooledLines), 1);
+  return true;
 }
 
 /***
- * Checks if maxima displayed a new prompt.
+ * Called when maxima displays a prompt. If the output was written to a file
+ * this inserts the summary which opens it.
  */
-void wxMaxima::ReadPrompt()
+void wxMaxima::EndFlood()
+{
+  m_outputCells = 0;
+  m_floodWindowBytes = 0;
+  m_floodSeconds = 0;
+  m_floodFailed = false;
+
+  if (!m_flooding)
+    return ;
+
+  m_flooding = false;
+  m_floodFile.Close();
+  m_console->InsertLine(new SpoolCell(m_floodFileName, m_spooledLines,
+                                      m_spooledBytes), true);
+}
+
+void wxMaxima::ReadLoadSymbols(wxString symbols)
+{
+  wxStringTokenizer templates(symbols, wxT("$"));
+  while (templates.HasMoreTokens())
+    m_console->AddSymbol(templates.GetNextToken());
+}
+
+/***
+ * Maxima dropped the first input of the queue, because an earlier input
+ * of the pipelined run ended with an error or was interrupted. All inputs
+ * sent after it are dropped, too. They are sent again in order, so the
+ * evaluation goes on as it does without pipelining.
+ */
+void wxMaxima::ReadSkipped()
+{
+  if (m_pipelineSkipped > 0)
+  {
+    m_pipelineSkipped--;
+    return;
+  }
+
+  m_pipelineSkipped = m_pipelineSent > 1 ? m_pipelineSent - 1 : 0;
+  m_pipelineSent = 0;
+  bool unsupported = !m_pipelineHadPrompt;
+  StopPipeline();
+
+  // Already the first input was dropped - this maxima can't pipeline
+  if (unsupported)
+    m_pipelineUnsupported = true;
+
+  TryEvaluateNextInQueue();
+}
+
+/***
+ * Maxima displayed a new prompt.
+ */
+void wxMaxima::ReadPrompt(wxString o)
 {
   bool ready = true;
-  int end = m_currentOutput.Find(m_promptSuffix);
-  if (end > -1)
+  if (o != wxT("\n") && o.Length())
   {
-    m_readingPrompt = false;
-    wxString o = m_currentOutput.Left(end);
-    if (o != wxT("\n") && o.Length())
+    // Maxima displayed a new main prompt
+    if (o.StartsWith(wxT("(%i")))
     {
-      // Maxima displayed a new main prompt
-      if (o.StartsWith(wxT("(%i")))
-      {
-        //m_lastPrompt = o.Mid(1,o.Length()-1);
-        //m_lastPrompt.Replace(wxT(")"), wxT(":"), false);
-        m_lastPrompt = o;
-        m_console->m_evaluationQueue->RemoveFirst(); // remove it from queue
-
-        if (m_console->m_evaluationQueue->Empty()) { // queue empty?
-          m_console->ShowHCaret();
-          m_console->SetWorkingGroup(NULL);
-          m_console->Refresh();
-        }
-        else { // we don't have an empty queue
-          m_console->Refresh();
-          m_console->EnableEdit();
-          ready = false;
-          TryEvaluateNextInQueue();
-        }
-
+      //m_lastPrompt = o.Mid(1,o.Length()-1);
+      //m_lastPrompt.Replace(wxT(")"), wxT(":"), false);
+      m_lastPrompt = o;
+      m_console->m_evaluationQueue->RemoveFirst(); // remove it from queue
+      if (m_pipelineSent > 0)
+        m_pipelineSent--;
+      m_pipelineHadPrompt = true;
+
+      if (m_console->m_evaluationQueue->Empty()) { // queue empty?
+        StopPipeline();
+        m_console->ShowHCaret();
+        m_console->SetWorkingGroup(NULL);
+        m_console->Refresh();
+      }
+      else { // we don't have an empty queue
+        m_console->Refresh();
         m_console->EnableEdit();
-
-        if (m_console->m_evaluationQueue->Empty())
-        {
-          bool open = false;
-          wxConfig::Get()->Read(wxT("openHCaret"), &open);
-          if (open)
-            m_console->OpenNextOrCreateCell();
-        }
+        ready = false;
+        TryEvaluateNextInQueue();
       }
 
-      // We have a question
-      else {
-        if (o.Find(wxT("<mth>")) > -1)
-          DoConsoleAppend(o, MC_TYPE_PROMPT);
-        else
-          DoRawConsoleAppend(o, MC_TYPE_PROMPT);
+      m_console->EnableEdit();
+
+      if (m_console->m_evaluationQueue->Empty())
+      {
+        bool open = false;
+        wxConfig::Get()->Read(wxT("openHCaret"), &open);
+        if (open)
+          m_console->OpenNextOrCreateCell();
       }
+    }
 
-      if (o.StartsWith(wxT("\nMAXIMA>")))
-        m_inLispMode = true;
+    // We have a question
+    else {
+      // Maxima drops the inputs sent ahead, they are sent again when
+      // the question is answered.
+      if (m_pipelineActive && !o.StartsWith(wxT("\nMAXIMA>")))
+      {
+        SendMaxima(wxT(":lisp-quiet (wx-pipeline-end)"));
+        if (m_pipelineSent > 1)
+          m_pipelineSent = 1;
+      }
+      if (o.Find(wxT("<mth>")) > -1)
+        DoConsoleAppend(o, MC_TYPE_PROMPT);
       else
-        m_inLispMode = false;
+        DoRawConsoleAppend(o, MC_TYPE_PROMPT);
     }
 
-    if (ready)
-      SetStatusText(_("Ready for user input"), 1);
-    m_currentOutput = m_currentOutput.SubString(end + m_promptSuffix.Length(),
-                      m_currentOutput.Length());
+    if (o.StartsWith(wxT("\nMAXIMA>")))
+      m_inLispMode = true;
+    else
+      m_inLispMode = false;
   }
+
+  if (ready)
+    SetStatusText(_("Ready for user input"), 1);
 }
 
 // OpenWXM(X)File
@@ -1394,20 +1924,20 @@ GroupCell* wxMaxima::CreateTreeFromWXMCode(wxArrayString* wxmLines)
 /***
  * This works only for gcl by default - other lisps have different prompts.
  */
-void wxMaxima::ReadLispError()
+void wxMaxima::ReadLispError(wxString o)
 {
   static const wxString lispError = wxT("dbl:MAXIMA>>"); // gcl
-  int end = m_currentOutput.Find(lispError);
-  if (end > -1)
+  m_inLispMode = true;
+  // Inputs sent ahead are read by the debugger, they are sent again
+  // after the debugger is left.
+  if (m_pipelineActive)
   {
-    m_readingPrompt = false;
-    m_inLispMode = true;
-    wxString o = m_currentOutput.Left(end);
-    ConsoleAppend(o, MC_TYPE_DEFAULT);
-    ConsoleAppend(lispError, MC_TYPE_PROMPT);
-    SetStatusText(_("Ready for user input"), 1);
-    m_currentOutput = wxEmptyString;
+    StopPipeline();
+    m_pipelineSent = 0;
   }
+  ConsoleAppend(o, MC_TYPE_DEFAULT);
+  ConsoleAppend(lispError, MC_TYPE_PROMPT);
+  SetStatusText(_("Ready for user input"), 1);
 }
 
 #ifndef __WXMSW__
@@ -1462,6 +1992,11 @@ void wxMaxima::SetupVariables()
              wxT("/share/wxMaxima/wxmathml\")"));
 #endif
 
+  bool framedProtocol = false;
+  wxConfig::Get()->Read(wxT("framedProtocol"), &framedProtocol);
+  if (framedProtocol)
+    SendMaxima(wxT(":lisp-quiet (setf *wx-framed* t)"));
+
   if (m_currentFile != wxEmptyString)
   {
     wxString filename(m_currentFile);
@@ -4113,6 +4648,15 @@ void wxMaxima::PopupMenu(wxCommandEvent& event)
   case popid_merge_cells:
     m_console->MergeCells();
     break;
+  case popid_remove_from_queue:
+    {
+      // The groups already sent to maxima can't be taken back
+      GroupCell *group = dynamic_cast<GroupCell*>(m_console->GetSelectionStart());
+      if (group != NULL &&
+          m_console->m_evaluationQueue->Remove(group, MAX(m_pipelineSent, 1)))
+        m_console->Refresh();
+    }
+    break;
   }
 }
 
@@ -4196,6 +4740,7 @@ void wxMaxima::TryEvaluateNextInQueue()
 
     while (!m_console->m_evaluationQueue->Empty())
       m_console->m_evaluationQueue->RemoveFirst();
+    ResetPipeline();
 
     m_console->Refresh();
 
@@ -4222,14 +4767,110 @@ void wxMaxima::TryEvaluateNextInQueue()
       return;
     }
 
+    // time the preprocessing of a large input
+    if (text.IsSameAs(wxT("wxmaxima_debug_benchmark_input;"))) {
+      m_console->m_evaluationQueue->RemoveFirst();
+      BenchmarkInput();
+      return;
+    }
+
+    // build and draw a very long row of cells
+    if (text.IsSameAs(wxT("wxmaxima_debug_benchmark_cells;"))) {
+      m_console->m_evaluationQueue->RemoveFirst();
+      BenchmarkCells();
+      return;
+    }
+
+    // compare a long output shown in parts with the full output
+    if (text.IsSameAs(wxT("wxmaxima_debug_test_lazy_output;"))) {
+      m_console->m_evaluationQueue->RemoveFirst();
+      TestLazyOutput();
+      return;
+    }
+
+    // show how the output of the last evaluation was displayed
+    if (text.IsSameAs(wxT("wxmaxima_debug_output_stats;"))) {
+      m_console->m_evaluationQueue->RemoveFirst();
+      wxMessageBox(wxString::Format(_("Output lines inserted: %ld\n"
+                                      "Layout passes: %ld\n"
+                                      "Groups measured: %ld\n"
+                                      "Style snapshots built: %ld\n"
+                                      "Fonts created: %ld (%ld cached)\n"
+                                      "Text extents: %ld cached, %ld measured\n"
+                                      "Tiles: %ld rendered, %ld reused\n"
+                                      "Outputs: %ld rendered, %ld reused (%ld kB)\n"
+                                      "Cell pool: %ld cells (%ld kB)\n"
+                                      "Shared subtrees: %ld (%ld occurrences)"),
+                                    m_console->GetOutputLines(),
+                                    m_console->GetOutputFlushes(),
+                                    m_console->GetGroupsMeasured(),
+                                    StyleSnapshot::GetBuildCount(),
+                                    FontCache::GetCreated(),
+                                    FontCache::GetCount(),
+                                    FontCache::GetExtentHits(),
+                                    FontCache::GetExtentMisses(),
+                                    m_console->GetTilesRendered(),
+                                    m_console->GetTilesReused(),
+                                    OutputCache::GetRendered(),
+                                    OutputCache::GetHits(),
+                                    OutputCache::GetBytes() / 1024,
+                                    CellPool::GetCells(),
+                                    CellPool::GetBytes() / 1024,
+                                    SharedCell::GetTrees(),
+                                    SharedCell::GetCells()),
+                   _("Output statistics"));
+      return;
+    }
+
+    // show what the cells of the document take
+    if (text.IsSameAs(wxT("wxmaxima_debug_memory_report;"))) {
+      m_console->m_evaluationQueue->RemoveFirst();
+      wxMessageBox(m_console->GetMemoryReport(), _("Memory usage"));
+      return;
+    }
+
+    // hatch the parts of the document which are repainted
+    if (text.IsSameAs(wxT("wxmaxima_debug_flash_repaints;"))) {
+      m_console->m_evaluationQueue->RemoveFirst();
+      m_console->SetFlashRepaints(!m_console->GetFlashRepaints());
+      return;
+    }
+
     group->RemoveOutput();
 
     m_console->SetWorkingGroup(group);
     group->GetPrompt()->SetValue(m_lastPrompt);
     m_console->Recalculate();
     m_console->ScrollToCell(group);
+    m_console->ResetOutputStats();
+
+    // The group may have been sent ahead already
+    if (m_pipelineSent == 0)
+    {
+      if (!m_pipelineActive && !m_pipelineUnsupported && CanPipeline(text))
+      {
+        m_pipelineDepth = 1;
+        wxConfig::Get()->Read(wxT("pipelineDepth"), &m_pipelineDepth);
+        if (m_pipelineDepth > 1)
+        {
+          m_pipelineCancelFile = wxFileName::CreateTempFileName(wxT("wxmaxima"));
+          wxRemoveFile(m_pipelineCancelFile);
+          wxString cancelFile = m_pipelineCancelFile;
+          cancelFile.Replace(wxT("\\"), wxT("/"));
+          SendMaxima(wxT(":lisp-quiet (wx-pipeline-start \"") + cancelFile + wxT("\")"));
+          m_pipelineActive = true;
+          m_pipelineHadPrompt = false;
+        }
+      }
+
+      if (m_pipelineActive && CanPipeline(text))
+        SendPipelined(text);
+      else
+        SendMaxima(text, true);
+      m_pipelineSent = 1;
+    }
 
-    SendMaxima(text, true);
+    FillPipeline();
   }
   else
   {
@@ -4238,6 +4879,88 @@ void wxMaxima::TryEvaluateNextInQueue()
   }
 }
 
+/***
+ * Inputs which are read by the lisp reader or handled by wxMaxima can't
+ * be sent ahead.
+ */
+bool wxMaxima::CanPipeline(wxString text)
+{
+  if (m_inLispMode)
+    return false;
+  if (text.StartsWith(wxT("wxmaxima_debug_")))
+    return false;
+  if (text.Find(wxT(":lisp")) != wxNOT_FOUND ||
+      text.Find(wxT("to_lisp")) != wxNOT_FOUND)
+    return false;
+  return true;
+}
+
+/***
+ * Sends an input of a pipelined run. Maxima drops it if an earlier input
+ * of the run failed (see wx-gate in wxmathml.lisp).
+ */
+void wxMaxima::SendPipelined(wxString text)
+{
+  SendMaxima(wxT(":lisp-quiet (wx-gate)"));
+  SendMaxima(text, true);
+}
+
+/***
+ * Sends the queued groups behind the working group until m_pipelineDepth
+ * groups are in flight. Stops at the first group which can't be sent ahead,
+ * it is sent when it becomes the working group.
+ */
+void wxMaxima::FillPipeline()
+{
+  if (!m_pipelineActive)
+    return;
+
+  GroupCell *group;
+  while (m_pipelineSent < m_pipelineDepth &&
+         (group = m_console->m_evaluationQueue->GetAt(m_pipelineSent)) != NULL)
+  {
+    if (group->GetEditable()->GetValue() == wxEmptyString)
+      break;
+
+    group->GetEditable()->AddEnding();
+    wxString text = group->GetEditable()->ToString(false);
+    if (!CanPipeline(text))
+      break;
+
+    group->GetEditable()->ContainsChanges(false);
+    SendPipelined(text);
+    m_pipelineSent++;
+  }
+}
+
+/***
+ * Tells maxima that the pipelined run is over. Groups which were sent
+ * ahead and not evaluated stay in the queue.
+ */
+void wxMaxima::StopPipeline()
+{
+  if (m_pipelineActive && m_isConnected)
+    SendMaxima(wxT(":lisp-quiet (wx-pipeline-stop)"));
+  if (m_pipelineCancelFile.Length() && wxFileExists(m_pipelineCancelFile))
+    wxRemoveFile(m_pipelineCancelFile);
+  m_pipelineCancelFile = wxEmptyString;
+  m_pipelineActive = false;
+}
+
+/***
+ * Forgets the pipelined run when maxima is restarted or lost.
+ */
+void wxMaxima::ResetPipeline()
+{
+  if (m_pipelineCancelFile.Length() && wxFileExists(m_pipelineCancelFile))
+    wxRemoveFile(m_pipelineCancelFile);
+  m_pipelineCancelFile = wxEmptyString;
+  m_pipelineActive = false;
+  m_pipelineHadPrompt = false;
+  m_pipelineSent = 0;
+  m_pipelineSkipped = 0;
+}
+
 void wxMaxima::InsertMenu(wxCommandEvent& event)
 {
   int type = 0;
@@ -4783,6 +5506,12 @@ BEGIN_EVENT_TABLE(wxMaxima, wxFrame)
 #endif
   EVT_SOCKET(socket_server_id, wxMaxima::ServerEvent)
   EVT_SOCKET(socket_client_id, wxMaxima::ClientEvent)
+#if WXM_READER_THREAD
+  EVT_COMMAND(wxID_ANY, wxEVT_MAXIMA_READER, wxMaxima::OnReaderEvent)
+#endif
+#if WXM_PARSER_THREADS
+  EVT_COMMAND(wxID_ANY, wxEVT_PARSER_POOL, wxMaxima::OnParserEvent)
+#endif
   EVT_UPDATE_UI(menu_interrupt_id, wxMaxima::UpdateMenus)
   EVT_UPDATE_UI(plot_slider_id, wxMaxima::UpdateSlider)
   EVT_UPDATE_UI(menu_copy_from_console, wxMaxima::UpdateMenus)
@@ -4843,6 +5572,7 @@ BEGIN_EVENT_TABLE(wxMaxima, wxFrame)
   EVT_MENU(popid_comment_selection, wxMaxima::PopupMenu)
   EVT_MENU(popid_divide_cell, wxMaxima::PopupMenu)
   EVT_MENU(popid_evaluate, wxMaxima::PopupMenu)
+  EVT_MENU(popid_remove_from_queue, wxMaxima::PopupMenu)
   EVT_MENU(popid_merge_cells, wxMaxima::PopupMenu)
   EVT_MENU(menu_evaluate_all_visible, wxMaxima::MaximaMenu)
   EVT_MENU(menu_evaluate_all, wxMaxima::MaximaMenu)
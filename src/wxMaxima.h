@@ -23,6 +23,10 @@
 
 #include "wxMaximaFrame.h"
 #include "MathParser.h"
+#include "MaximaStream.h"
+#include "MaximaReader.h"
+#include "ParserPool.h"
+#include "InputPreprocessor.h"
 
 #include <wx/socket.h>
 #include <wx/config.h>
@@ -31,6 +35,7 @@
 #include <wx/regex.h>
 #include <wx/html/htmlwin.h>
 #include <wx/dnd.h>
+#include <wx/file.h>
 
 #if defined (__WXMSW__)
  #include <wx/msw/helpchm.h>
@@ -38,10 +43,11 @@
  #include <wx/html/helpctrl.h>
 #endif
 
-#define SOCKET_SIZE 1024
 #define DOCUMENT_VERSION_MAJOR 1
 #define DOCUMENT_VERSION_MINOR 1
 
+#define FLOOD_SECONDS 3  // seconds above the flood rate before output is spooled
+
 class MyApp : public wxApp
 {
 public:
@@ -83,7 +89,6 @@ public:
   {
     m_openFile = file;
   }
-  void StripComments(wxString& s);
   void SendMaxima(wxString s, bool history = false);
   void OpenFile(wxString file,
                 wxString command = wxEmptyString); // Open a file
@@ -118,14 +123,28 @@ protected:
   void OnReplace(wxFindDialogEvent& event);
   void OnReplaceAll(wxFindDialogEvent& event);
 
-  void SanitizeSocketBuffer(char *buffer, int length);  // fix early nulls
+  size_t ReadSocket();                                  // drains the socket into m_maximaStream
   void ServerEvent(wxSocketEvent& event);          // server event: maxima connection
   void ClientEvent(wxSocketEvent& event);          // client event: maxima input/output
+  void SocketLost();                               // connection to maxima is lost
+#if WXM_READER_THREAD
+  void OnReaderEvent(wxCommandEvent& event);       // frames from m_reader
+  void StopReader();
+#endif
 
   void ConsoleAppend(wxString s, int type);        // append maxima output to console
   void DoConsoleAppend(wxString s, int type,       //
                        bool newLine = true, bool bigSkip = true);
   void DoRawConsoleAppend(wxString s, int type);   //
+  void InsertParsedLine(MathCell *cell,            // inserts output parsed by
+                        bool newLine, bool bigSkip); //   DoConsoleAppend
+  void FlushParses();                              // waits for m_parserPool
+#if WXM_PARSER_THREADS
+  bool ParseInPool(wxString s, int type,           // parses s in m_parserPool
+                   bool newLine, bool bigSkip);
+  void OnParserEvent(wxCommandEvent& event);       // m_parserPool finished a job
+  void StopParserPool(bool flush = true);
+#endif
 
   void EditInputMenu(wxCommandEvent& event);       //
   void EvaluateEvent(wxCommandEvent& event);       //
@@ -134,8 +153,16 @@ protected:
   void HistoryDClick(wxCommandEvent& event);
   void OnInspectorEvent(wxCommandEvent& ev);
   void DumpProcessOutput();
+  void BenchmarkInput();
+  void BenchmarkCells();
+  void TestLazyOutput();
   void TryEvaluateNextInQueue();
   void TryUpdateInspector();
+  bool CanPipeline(wxString text);                 // can text be sent ahead?
+  void SendPipelined(wxString text);               // sends text behind a gate
+  void FillPipeline();                             // sends queued groups ahead
+  void StopPipeline();                             // ends the pipelined run
+  void ResetPipeline();                            // forgets the pipeline state
 
 #if WXM_PRINT
   void CheckForPrintingSupport();
@@ -151,12 +178,17 @@ protected:
   wxString GetCommand(bool params = true);         // returns the command to start maxima
                                                    //    (uses guessConfiguration)
 
-  void ReadFirstPrompt();            // reads everything before first prompt
+  void ReadMaximaStream();           // dispatches frames from m_maximaStream
+  void ReadFrame(int type, wxString data); // dispatches a single frame
+  void ReadFirstPrompt(wxString data); // reads everything before first prompt
   // setsup m_pid
-  void ReadPrompt();                 // reads prompts
-  void ReadMath();                   // reads output other than prompts
-  void ReadLispError();              // lisp errors (no prompt prefix/suffix)
-  void ReadLoadSymbols();            // functions after load command
+  void ReadPrompt(wxString o);       // reads prompts
+  void ReadMath(wxString o);         // reads output other than prompts
+  void ReadLispError(wxString o);    // lisp errors (no prompt prefix/suffix)
+  void ReadLoadSymbols(wxString symbols); // functions after load command
+  void ReadSkipped();                // maxima dropped a pipelined input
+  bool SpoolOutput(wxString o);      // writes o to a file when maxima floods us
+  void EndFlood();                   // an evaluation ended, shows the summary
 #ifndef __WXMSW__
   void ReadProcessOutput();          // reads output of maxima command
 #endif
@@ -178,19 +210,41 @@ protected:
   wxSocketServer *m_server;
   bool m_isConnected;
   bool m_isRunning;
-  bool m_first;
   long m_pid;
   wxProcess *m_process;
   wxInputStream *m_input;
   int m_port;
-  wxString m_currentOutput;
+  MaximaStream m_maximaStream;      // output read from the socket
+#if WXM_READER_THREAD
+  MaximaReader *m_reader;           // reads the socket in a thread (optional)
+#endif
+#if WXM_PARSER_THREADS
+  ParserPool *m_parserPool;         // parses outputs in threads (optional)
+#endif
+  size_t m_socketReadSize;          // size of a single read, adapts to the output
   wxString m_promptSuffix;
   wxString m_promptPrefix;
   wxString m_firstPrompt;
-  bool m_readingPrompt;
   bool m_dispReadOut;               // what is displayed in statusbar
   bool m_inLispMode;                // don't add ; in lisp mode
   wxString m_lastPrompt;
+  int m_pipelineDepth;              // groups sent before the prompt of the first
+  int m_pipelineSent;               // queued groups already sent to maxima
+  int m_pipelineSkipped;            // skipped notices still expected
+  bool m_pipelineActive;            // maxima knows about the current run
+  bool m_pipelineHadPrompt;         // an input of the run was evaluated
+  bool m_pipelineUnsupported;       // maxima can't pipeline
+  wxString m_pipelineCancelFile;    // created to stop the run after an interrupt
+  long m_outputCells;               // cells added since the last prompt
+  long m_floodWindowBytes;          // output read in the current second
+  wxLongLong m_floodWindowStart;    // start of that second
+  int m_floodSeconds;               // seconds in a row above the rate
+  bool m_flooding;                  // output goes to m_floodFile until the prompt
+  bool m_floodFailed;               // the file couldn't be written, until the prompt
+  wxFile m_floodFile;
+  wxString m_floodFileName;
+  long m_spooledLines, m_spooledBytes;
+  wxArrayString m_spoolFiles;       // removed on exit
   wxString m_lastPath;
   MathParser m_MParser;
   wxPrintData* m_printData;
@@ -212,9 +266,7 @@ protected:
 #endif
   wxFindReplaceDialog *m_findDialog;
   wxFindReplaceData m_findData;
-  wxRegEx m_funRegEx;
-  wxRegEx m_varRegEx;
-  wxRegEx m_blankStatementRegEx;
+  InputPreprocessor m_inputPreprocessor;
 #if wxUSE_DRAG_AND_DROP
   friend class MyDropTarget;
 #endif